@@ -4,6 +4,32 @@
 
 #define offset(member) ((uint_ptr)&this->member - (uint_ptr)this)
 
+static unsigned int text_decoration_flags(const litehtml::string& decoration)
+{
+	unsigned int decor = litehtml::font_decoration_none;
+	if(decoration.empty() || decoration == "none")
+	{
+		return decor;
+	}
+
+	litehtml::string_vector tokens;
+	litehtml::split_string(decoration, tokens, " ");
+	for(auto & token : tokens)
+	{
+		if(!litehtml::t_strcasecmp(token.c_str(), "underline"))
+		{
+			decor |= litehtml::font_decoration_underline;
+		} else if(!litehtml::t_strcasecmp(token.c_str(), "line-through"))
+		{
+			decor |= litehtml::font_decoration_linethrough;
+		} else if(!litehtml::t_strcasecmp(token.c_str(), "overline"))
+		{
+			decor |= litehtml::font_decoration_overline;
+		}
+	}
+	return decor;
+}
+
 void litehtml::css_properties::compute(const element* el, const document::ptr& doc)
 {
 	compute_font(el, doc);
@@ -347,11 +373,11 @@ void litehtml::css_properties::compute_font(const element* el, const document::p
 	m_text_decoration	=               el->get_string_property(_text_decoration_,	true, "none",										offset(m_text_decoration));
 
 	m_font = doc->get_font(
-		m_font_family.c_str(), 
-		font_size, 
-		index_value(m_font_weight, font_weight_strings).c_str(), 
-		index_value(m_font_style, font_style_strings).c_str(),
-		m_text_decoration.c_str(), 
+		m_font_family,
+		font_size,
+		m_font_weight,
+		m_font_style,
+		text_decoration_flags(m_text_decoration),
 		&m_font_metrics);
 }
 
@@ -311,6 +311,114 @@ void litehtml::css_selector::calc_specificity()
 	}
 }
 
+void litehtml::css_selector::calc_ancestor_hashes()
+{
+	int count = 0;
+	for(const css_selector* sel = this; sel->m_left && count < selector_filter::max_selector_hashes; sel = sel->m_left.get())
+	{
+		// A compound left of a sibling combinator is a sibling of the subject or
+		// of one of its ancestors; left of a descendant or child combinator it is
+		// an ancestor of the subject in either case
+		if(sel->m_combinator != combinator_descendant && sel->m_combinator != combinator_child)
+		{
+			continue;
+		}
+
+		const css_element_selector& compound = sel->m_left->m_right;
+		for(const auto& attr : compound.m_attrs)
+		{
+			if(count < selector_filter::max_selector_hashes && (attr.type == select_id || attr.type == select_class))
+			{
+				m_ancestor_hashes[count++] = selector_filter::key_hash(attr.type == select_id ? selector_filter::key_id : selector_filter::key_class, attr.name);
+			}
+		}
+		if(count < selector_filter::max_selector_hashes && compound.m_tag != star_id)
+		{
+			m_ancestor_hashes[count++] = selector_filter::key_hash(selector_filter::key_tag, compound.m_tag);
+		}
+	}
+	std::fill(m_ancestor_hashes + count, std::end(m_ancestor_hashes), 0);
+}
+
+static bool depends_on_position(const litehtml::css_element_selector& sel)
+{
+	for(const auto& attr : sel.m_attrs)
+	{
+		if(attr.type != litehtml::select_pseudo_class)
+		{
+			continue;
+		}
+		switch(attr.name)
+		{
+		case litehtml::_only_child_:
+		case litehtml::_only_of_type_:
+		case litehtml::_first_child_:
+		case litehtml::_first_of_type_:
+		case litehtml::_last_child_:
+		case litehtml::_last_of_type_:
+		case litehtml::_nth_child_:
+		case litehtml::_nth_of_type_:
+		case litehtml::_nth_last_child_:
+		case litehtml::_nth_last_of_type_:
+			return true;
+		case litehtml::_not_:
+			if(attr.sel && depends_on_position(*attr.sel))
+			{
+				return true;
+			}
+			break;
+		default:
+			break;
+		}
+	}
+	return false;
+}
+
+void litehtml::css_selector::calc_position_sensitivity()
+{
+	// Siblings share all ancestors, so only the rightmost compound and the
+	// combinator next to it can tell them apart
+	m_position_sensitive = depends_on_position(m_right) ||
+		(m_left && (m_combinator == combinator_adjacent_sibling || m_combinator == combinator_general_sibling));
+
+	// Cousins have different parents, so the rest of the chain counts as well
+	m_ancestors_position_sensitive = false;
+	for(const css_selector* sel = m_left.get(); sel && !m_ancestors_position_sensitive; sel = sel->m_left.get())
+	{
+		m_ancestors_position_sensitive = depends_on_position(sel->m_right) ||
+			(sel->m_left && (sel->m_combinator == combinator_adjacent_sibling || sel->m_combinator == combinator_general_sibling));
+	}
+}
+
+static bool depends_on_state(const litehtml::css_element_selector& sel)
+{
+	for(const auto& attr : sel.m_attrs)
+	{
+		if(attr.type != litehtml::select_pseudo_class)
+		{
+			continue;
+		}
+		if(attr.name == litehtml::_hover_ || attr.name == litehtml::_active_)
+		{
+			return true;
+		}
+		if(attr.name == litehtml::_not_ && attr.sel && depends_on_state(*attr.sel))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void litehtml::css_selector::calc_state_sensitivity()
+{
+	m_state_sensitive = false;
+	for(const css_selector* sel = this; sel && !m_state_sensitive; sel = sel->m_left.get())
+	{
+		m_state_sensitive = depends_on_state(sel->m_right);
+	}
+}
+
 void litehtml::css_selector::add_media_to_doc( document* doc ) const
 {
 	if(m_media_query && doc)
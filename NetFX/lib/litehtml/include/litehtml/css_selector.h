@@ -3,6 +3,7 @@
 
 #include "style.h"
 #include "media_query.h"
+#include "selector_filter.h"
 
 namespace litehtml
 {
@@ -193,12 +194,24 @@ namespace litehtml
 		style::ptr				m_style;
 		int						m_order;
 		media_query_list::ptr	m_media_query;
+		// Keys ancestors must have for a match, see selector_filter; 0 ends the list
+		unsigned				m_ancestor_hashes[selector_filter::max_selector_hashes];
+		// Whether the match depends on the position of the element (or of one of
+		// its ancestors) among its siblings, which rules out style sharing
+		bool					m_position_sensitive;
+		bool					m_ancestors_position_sensitive;
+		// Whether the match can change with the :hover or :active state of some element
+		bool					m_state_sensitive;
 	public:
 		explicit css_selector(const media_query_list::ptr& media = nullptr)
 		{
 			m_media_query	= media;
 			m_combinator	= combinator_descendant;
 			m_order			= 0;
+			std::fill(std::begin(m_ancestor_hashes), std::end(m_ancestor_hashes), 0);
+			m_position_sensitive = false;
+			m_ancestors_position_sensitive = false;
+			m_state_sensitive = false;
 		}
 
 		~css_selector() = default;
@@ -217,10 +230,17 @@ namespace litehtml
 			m_specificity	= val.m_specificity;
 			m_order			= val.m_order;
 			m_media_query	= val.m_media_query;
+			std::copy(std::begin(val.m_ancestor_hashes), std::end(val.m_ancestor_hashes), m_ancestor_hashes);
+			m_position_sensitive = val.m_position_sensitive;
+			m_ancestors_position_sensitive = val.m_ancestors_position_sensitive;
+			m_state_sensitive = val.m_state_sensitive;
 		}
 
 		bool parse(const string& text);
 		void calc_specificity();
+		void calc_ancestor_hashes();
+		void calc_position_sensitivity();
+		void calc_state_sensitivity();
 		bool is_media_valid() const;
 		void add_media_to_doc(document* doc) const;
 	};
@@ -3,6 +3,7 @@
 #include "stylesheet.h"
 #include "html_tag.h"
 #include "el_text.h"
+#include "el_text_run.h"
 #include "el_para.h"
 #include "el_space.h"
 #include "el_body.h"
@@ -24,6 +25,7 @@
 #include <cmath>
 #include <cstdio>
 #include <algorithm>
+#include <unordered_set>
 #include "gumbo/gumbo.h"
 #include "utf8_strings.h"
 #include "render_item.h"
@@ -33,6 +35,8 @@
 litehtml::document::document(document_container* objContainer)
 {
 	m_container	= objContainer;
+	m_render_width = 0;
+	m_uses_viewport_units = false;
 }
 
 litehtml::document::~document()
@@ -48,9 +52,19 @@ litehtml::document::~document()
 }
 
 litehtml::document::ptr litehtml::document::createFromString( const char* str, document_container* objPainter, const char* master_styles, const char* user_styles )
+{
+	return createFromString(str, objPainter, css::create_shared(master_styles, objPainter), css::create_shared(user_styles, objPainter));
+}
+
+litehtml::document::ptr litehtml::document::createFromString( const char* str, document_container* objPainter, const css::const_ptr& master_styles, const css::const_ptr& user_styles )
+{
+	return createFromString(str, strlen(str), objPainter, master_styles, user_styles);
+}
+
+litehtml::document::ptr litehtml::document::createFromString( const char* str, size_t length, document_container* objPainter, const css::const_ptr& master_styles, const css::const_ptr& user_styles )
 {
 	// parse document into GumboOutput
-	GumboOutput* output = gumbo_parse(str);
+	GumboOutput* output = gumbo_parse_with_options(&kGumboDefaultOptions, str, length);
 
 	// Create litehtml::document
 	document::ptr doc = std::make_shared<document>(objPainter);
@@ -65,16 +79,10 @@ litehtml::document::ptr litehtml::document::createFromString( const char* str, d
 	// Destroy GumboOutput
 	gumbo_destroy_output(&kGumboDefaultOptions, output);
 
-	if (master_styles && *master_styles)
-	{
-		doc->m_master_css.parse_stylesheet(master_styles, nullptr, doc, nullptr);
-		doc->m_master_css.sort_selectors();
-	}
-	if (user_styles && *user_styles)
-	{
-		doc->m_user_css.parse_stylesheet(user_styles, nullptr, doc, nullptr);
-		doc->m_user_css.sort_selectors();
-	}
+	doc->m_master_css = master_styles ? css::with_own_media(master_styles) : std::make_shared<css>();
+	doc->m_user_css = user_styles ? css::with_own_media(user_styles) : std::make_shared<css>();
+	doc->m_master_css->add_media_to_doc(doc.get());
+	doc->m_user_css->add_media_to_doc(doc.get());
 
 	// Let's process created elements tree
 	if (doc->m_root)
@@ -83,8 +91,11 @@ litehtml::document::ptr litehtml::document::createFromString( const char* str, d
 
 		doc->m_root->set_pseudo_class(_root_, true);
 
+		// Ancestor keys for selector matching; every traversal leaves it empty again
+		selector_filter filter;
+
 		// apply master CSS
-		doc->m_root->apply_stylesheet(doc->m_master_css);
+		doc->m_root->apply_stylesheet(*doc->m_master_css, filter);
 
 		// parse elements attributes
 		doc->m_root->parse_attributes();
@@ -113,10 +124,10 @@ litehtml::document::ptr litehtml::document::createFromString( const char* str, d
 		}
 
 		// Apply parsed styles.
-		doc->m_root->apply_stylesheet(doc->m_styles);
+		doc->m_root->apply_stylesheet(doc->m_styles, filter);
 
 		// Apply user styles if any
-		doc->m_root->apply_stylesheet(doc->m_user_css);
+		doc->m_root->apply_stylesheet(*doc->m_user_css, filter);
 
 		// Initialize m_css
 		doc->m_root->compute_styles();
@@ -137,145 +148,82 @@ litehtml::document::ptr litehtml::document::createFromString( const char* str, d
 	return doc;
 }
 
-litehtml::uint_ptr litehtml::document::add_font( const char* name, int size, const char* weight, const char* style, const char* decoration, font_metrics* fm )
+uint64_t litehtml::document::font_key(uint32_t family, int size, font_weight weight, font_style style, unsigned int decoration)
 {
-	uint_ptr ret = 0;
+	// family:24 size:24 weight:8 style:4 decoration:4
+	return	((uint64_t) (family & 0xFFFFFF) << 40) |
+			((uint64_t) (size & 0xFFFFFF) << 16) |
+			((uint64_t) (weight & 0xFF) << 8) |
+			((uint64_t) (style & 0x0F) << 4) |
+			(uint64_t) (decoration & 0x0F);
+}
 
-	if(!name)
+litehtml::uint_ptr litehtml::document::add_font( const char* name, int size, font_weight weight, font_style style, unsigned int decoration, font_metrics* fm )
+{
+	int fw = 400;
+	switch(weight)
 	{
-		name = m_container->get_default_font_name();
+	case litehtml::font_weight_bold:
+		fw = 700;
+		break;
+	case litehtml::font_weight_bolder:
+		fw = 600;
+		break;
+	case litehtml::font_weight_lighter:
+		fw = 300;
+		break;
+	case litehtml::font_weight_normal:
+		fw = 400;
+		break;
+	case litehtml::font_weight_100:
+		fw = 100;
+		break;
+	case litehtml::font_weight_200:
+		fw = 200;
+		break;
+	case litehtml::font_weight_300:
+		fw = 300;
+		break;
+	case litehtml::font_weight_400:
+		fw = 400;
+		break;
+	case litehtml::font_weight_500:
+		fw = 500;
+		break;
+	case litehtml::font_weight_600:
+		fw = 600;
+		break;
+	case litehtml::font_weight_700:
+		fw = 700;
+		break;
+	case litehtml::font_weight_800:
+		fw = 800;
+		break;
+	case litehtml::font_weight_900:
+		fw = 900;
+		break;
 	}
 
-	char strSize[20];
-	t_itoa(size, strSize, 20, 10);
-
-	string key = name;
-	key += ":";
-	key += strSize;
-	key += ":";
-	key += weight;
-	key += ":";
-	key += style;
-	key += ":";
-	key += decoration;
-
-	if(m_fonts.find(key) == m_fonts.end())
-	{
-		font_style fs = (font_style) value_index(style, font_style_strings, font_style_normal);
-		int	fw = value_index(weight, font_weight_strings, -1);
-		if(fw >= 0)
-		{
-			switch(fw)
-			{
-			case litehtml::font_weight_bold:
-				fw = 700;
-				break;
-			case litehtml::font_weight_bolder:
-				fw = 600;
-				break;
-			case litehtml::font_weight_lighter:
-				fw = 300;
-				break;
-			case litehtml::font_weight_normal:
-				fw = 400;
-				break;
-			case litehtml::font_weight_100:
-				fw = 100;
-				break;
-			case litehtml::font_weight_200:
-				fw = 200;
-				break;
-			case litehtml::font_weight_300:
-				fw = 300;
-				break;
-			case litehtml::font_weight_400:
-				fw = 400;
-				break;
-			case litehtml::font_weight_500:
-				fw = 500;
-				break;
-			case litehtml::font_weight_600:
-				fw = 600;
-				break;
-			case litehtml::font_weight_700:
-				fw = 700;
-				break;
-			case litehtml::font_weight_800:
-				fw = 800;
-				break;
-			case litehtml::font_weight_900:
-				fw = 900;
-				break;
-			}
-		} else
-		{
-			fw = atoi(weight);
-			if(fw < 100)
-			{
-				fw = 400;
-			}
-		}
-
-		unsigned int decor = 0;
-
-		if(decoration)
-		{
-			std::vector<string> tokens;
-			split_string(decoration, tokens, " ");
-			for(auto & token : tokens)
-			{
-				if(!t_strcasecmp(token.c_str(), "underline"))
-				{
-					decor |= font_decoration_underline;
-				} else if(!t_strcasecmp(token.c_str(), "line-through"))
-				{
-					decor |= font_decoration_linethrough;
-				} else if(!t_strcasecmp(token.c_str(), "overline"))
-				{
-					decor |= font_decoration_overline;
-				}
-			}
-		}
-
-		font_item fi= {0};
-
-		fi.font = m_container->create_font(name, size, fw, fs, decor, &fi.metrics);
-		m_fonts[key] = fi;
-		ret = fi.font;
-		if(fm)
-		{
-			*fm = fi.metrics;
-		}
-	}
-	return ret;
+	return m_container->create_font(name, size, fw, style, decoration, fm);
 }
 
-litehtml::uint_ptr litehtml::document::get_font( const char* name, int size, const char* weight, const char* style, const char* decoration, font_metrics* fm )
+litehtml::uint_ptr litehtml::document::get_font( const string& name, int size, font_weight weight, font_style style, unsigned int decoration, font_metrics* fm )
 {
 	if(!size)
 	{
 		return 0;
 	}
-	if(!name)
+
+	// Family names are interned, so a lookup does not build a string key
+	auto fam = m_font_families.find(name);
+	if(fam == m_font_families.end())
 	{
-		name = m_container->get_default_font_name();
+		fam = m_font_families.emplace(name, (uint32_t) m_font_families.size()).first;
 	}
 
-	char strSize[20];
-	t_itoa(size, strSize, 20, 10);
-
-	string key = name;
-	key += ":";
-	key += strSize;
-	key += ":";
-	key += weight;
-	key += ":";
-	key += style;
-	key += ":";
-	key += decoration;
+	uint64_t key = font_key(fam->second, size, weight, style, decoration);
 
 	auto el = m_fonts.find(key);
-
 	if(el != m_fonts.end())
 	{
 		if(fm)
@@ -284,7 +232,15 @@ litehtml::uint_ptr litehtml::document::get_font( const char* name, int size, con
 		}
 		return el->second.font;
 	}
-	return add_font(name, size, weight, style, decoration, fm);
+
+	font_item fi = {0};
+	fi.font = add_font(name.empty() ? m_container->get_default_font_name() : name.c_str(), size, weight, style, decoration, &fi.metrics);
+	m_fonts[key] = fi;
+	if(fm)
+	{
+		*fm = fi.metrics;
+	}
+	return fi.font;
 }
 
 int litehtml::document::render( int max_width, render_type rt )
@@ -306,6 +262,7 @@ int litehtml::document::render( int max_width, render_type rt )
 			m_root_render->render_positioned(rt);
 		} else
 		{
+			m_render_width = max_width;
 			ret = m_root_render->render(0, 0, cb_context, nullptr);
 			if(m_root_render->fetch_positioned())
 			{
@@ -372,15 +329,19 @@ int litehtml::document::to_pixels( const css_length& val, int fontSize, int size
 		ret = m_container->pt_to_px((int) (val.val() * 0.3937 * 72) / 10);
 		break;
 	case css_units_vw:
+		m_uses_viewport_units = true;
 		ret = (int)((double)m_media.width * (double)val.val() / 100.0);
 		break;
 	case css_units_vh:
+		m_uses_viewport_units = true;
 		ret = (int)((double)m_media.height * (double)val.val() / 100.0);
 		break;
 	case css_units_vmin:
+		m_uses_viewport_units = true;
 		ret = (int)((double)std::min(m_media.height, m_media.width) * (double)val.val() / 100.0);
 		break;
 	case css_units_vmax:
+		m_uses_viewport_units = true;
 		ret = (int)((double)std::max(m_media.height, m_media.width) * (double)val.val() / 100.0);
 		break;
 	case css_units_rem:
@@ -454,6 +415,171 @@ void litehtml::document::add_stylesheet( const char* str, const char* baseurl, c
 	}
 }
 
+void litehtml::document::add_state_dependent( const element::ptr& el )
+{
+	m_state_dependent.push_back(el);
+}
+
+bool litehtml::document::find_state_changes( position::vector& redraw_boxes )
+{
+	// Same result as m_root->find_styles_changes(), without matching every element again
+	std::vector<element::ptr> changed;
+	for(size_t i = 0; i < m_state_dependent.size();)
+	{
+		auto el = m_state_dependent[i].lock();
+		if(!el)
+		{
+			m_state_dependent[i] = std::move(m_state_dependent.back());
+			m_state_dependent.pop_back();
+			continue;
+		}
+		if(el->css().get_display() != display_inline_text && el->requires_styles_update())
+		{
+			changed.push_back(el);
+		}
+		i++;
+	}
+
+	std::unordered_set<const element*> changed_set;
+	for(const auto& el : changed)
+	{
+		changed_set.insert(el.get());
+	}
+
+	bool ret = false;
+	for(const auto& el : changed)
+	{
+		// Restyling an element restyles its subtree, which covers changed descendants.
+		// Elements no longer in the tree are left alone.
+		element::ptr top = el;
+		bool nested = false;
+		for(element::ptr ancestor = el->parent(); ancestor && !nested; ancestor = ancestor->parent())
+		{
+			nested = changed_set.count(ancestor.get()) != 0;
+			top = ancestor;
+		}
+		if(nested || top != m_root)
+		{
+			continue;
+		}
+		el->update_styles(redraw_boxes);
+		ret = true;
+	}
+	return ret;
+}
+
+void litehtml::document::find_image_boxes( const element::ptr& el, const std::unordered_set<string>& srcs, std::vector<std::shared_ptr<render_item>>& boxes, position::vector& redraw_boxes )
+{
+	auto img = dynamic_cast<el_image*>(el.get());
+	bool is_loaded_image = img && srcs.count(img->get_src());
+
+	// Background images are painted into the box they were sized for
+	bool is_loaded_background = false;
+	for(const auto& image : el->css().get_bg().m_image)
+	{
+		if(srcs.count(image))
+		{
+			is_loaded_background = true;
+			break;
+		}
+	}
+
+	if(is_loaded_image || is_loaded_background)
+	{
+		for(const auto& weak_ri : el->m_renders)
+		{
+			auto ri = weak_ri.lock();
+			if(!ri)
+			{
+				continue;
+			}
+			ri->get_rendering_boxes(redraw_boxes);
+			if(is_loaded_image)
+			{
+				boxes.push_back(ri);
+			}
+		}
+	}
+
+	for(const auto& child : el->children())
+	{
+		find_image_boxes(child, srcs, boxes, redraw_boxes);
+	}
+}
+
+bool litehtml::document::on_images_loaded( const string_vector& srcs, position::vector& redraw_boxes )
+{
+	if(!m_root || !m_root_render || srcs.empty())
+	{
+		return false;
+	}
+
+	std::unordered_set<string> loaded(srcs.begin(), srcs.end());
+	std::vector<std::shared_ptr<render_item>> boxes;
+	find_image_boxes(m_root, loaded, boxes, redraw_boxes);
+
+	// Lay out again the nearest ancestor whose own box cannot change, or the whole document
+	std::vector<std::shared_ptr<render_item>> boundaries;
+	bool full_layout = false;
+	for(const auto& ri : boxes)
+	{
+		if(!ri->intrinsic_size_changed())
+		{
+			continue;
+		}
+		ri->set_needs_layout();
+
+		std::shared_ptr<render_item> boundary;
+		for(auto ancestor = ri->parent(); ancestor && !boundary; ancestor = ancestor->parent())
+		{
+			if(ancestor->is_layout_boundary())
+			{
+				boundary = ancestor;
+			}
+		}
+		if(!boundary)
+		{
+			full_layout = true;
+			break;
+		}
+		boundaries.push_back(boundary);
+	}
+
+	if(full_layout)
+	{
+		// The document may also have become smaller
+		litehtml::size old_size = m_size;
+		render(m_render_width);
+		m_root_render->clear_needs_layout();
+		redraw_boxes.emplace_back(0, 0, std::max(old_size.width, m_size.width), std::max(old_size.height, m_size.height));
+		return true;
+	}
+
+	for(const auto& boundary : boundaries)
+	{
+		// Already laid out as part of an enclosing boundary
+		if(!boundary->needs_layout())
+		{
+			continue;
+		}
+		bool nested = false;
+		for(auto ancestor = boundary->parent(); ancestor && !nested; ancestor = ancestor->parent())
+		{
+			nested = std::find(boundaries.begin(), boundaries.end(), ancestor) != boundaries.end();
+		}
+		if(nested)
+		{
+			continue;
+		}
+
+		boundary->relayout();
+		boundary->get_rendering_boxes(redraw_boxes);
+	}
+
+	m_root_render->clear_needs_layout();
+	return !boundaries.empty();
+}
+
 bool litehtml::document::on_mouse_over( int x, int y, int client_x, int client_y, position::vector& redraw_boxes )
 {
 	if(!m_root || !m_root_render)
@@ -492,7 +618,7 @@ bool litehtml::document::on_mouse_over( int x, int y, int client_x, int client_y
 	
 	if(state_was_changed)
 	{
-		return m_root->find_styles_changes(redraw_boxes);
+		return find_state_changes(redraw_boxes);
 	}
 	return false;
 }
@@ -507,7 +633,7 @@ bool litehtml::document::on_mouse_leave( position::vector& redraw_boxes )
 	{
 		if(m_over_element->on_mouse_leave())
 		{
-			return m_root->find_styles_changes(redraw_boxes);
+			return find_state_changes(redraw_boxes);
 		}
 	}
 	return false;
@@ -558,7 +684,7 @@ bool litehtml::document::on_lbutton_down( int x, int y, int client_x, int client
 
 	if(state_was_changed)
 	{
-		return m_root->find_styles_changes(redraw_boxes);
+		return find_state_changes(redraw_boxes);
 	}
 
 	return false;
@@ -574,7 +700,7 @@ bool litehtml::document::on_lbutton_up( int x, int y, int client_x, int client_y
 	{
 		if(m_over_element->on_lbutton_up())
 		{
-			return m_root->find_styles_changes(redraw_boxes);
+			return find_state_changes(redraw_boxes);
 		}
 	}
 	return false;
@@ -665,14 +791,60 @@ void litehtml::document::add_fixed_box( const position& pos )
 
 bool litehtml::document::media_changed()
 {
+	int old_width = m_media.width;
+	int old_height = m_media.height;
 	container()->get_media_features(m_media);
-	if (update_media_lists(m_media))
+	bool viewport_resized = m_uses_viewport_units && (m_media.width != old_width || m_media.height != old_height);
+
+	// Only rules under a list whose result flipped can apply differently now
+	media_query_list::vector flipped;
+	for(const auto& list : m_media_lists)
 	{
-		m_root->refresh_styles();
+		if(list->apply_media_features(m_media))
+		{
+			flipped.push_back(list);
+		}
+	}
+	if((flipped.empty() && !viewport_resized) || !m_root)
+	{
+		return false;
+	}
+
+	position::vector redraw_boxes;
+	if(!flipped.empty())
+	{
+		update_media_dependent(m_root, flipped, redraw_boxes);
+	}
+	if(viewport_resized)
+	{
+		// Viewport lengths are resolved both into computed values (font-size,
+		// line-height) and during layout, where the layout cache cannot see them
 		m_root->compute_styles();
-		return true;
+		if(m_root_render)
+		{
+			m_root_render->invalidate_layout();
+		}
+	}
+	return true;
+}
+
+void litehtml::document::update_media_dependent( const element::ptr& el, const media_query_list::vector& flipped, position::vector& redraw_boxes )
+{
+	if(el->css().get_display() == display_inline_text)
+	{
+		return;
+	}
+
+	// Restyling an element restyles its subtree
+	if(el->depends_on_media(flipped))
+	{
+		el->update_styles(redraw_boxes);
+		return;
+	}
+	for(const auto& child : el->children())
+	{
+		update_media_dependent(child, flipped, redraw_boxes);
 	}
-	return false;
 }
 
 bool litehtml::document::lang_changed()
@@ -691,6 +863,10 @@ bool litehtml::document::lang_changed()
 		}
 		m_root->refresh_styles();
 		m_root->compute_styles();
+		if(m_root_render)
+		{
+			m_root_render->invalidate_layout();
+		}
 		return true;
 	}
 	return false;
@@ -782,9 +958,8 @@ void litehtml::document::create_node(void* gnode, elements_list& elements, bool
 			}
 			else
 			{
-				m_container->split_text(node->v.text.text,
-					[this, &elements](const char* text) { elements.push_back(std::make_shared<el_text>(text, shared_from_this())); },
-					[this, &elements](const char* text) { elements.push_back(std::make_shared<el_space>(text, shared_from_this())); });
+				// One element for the whole node, the words are pieces of it
+				elements.push_back(std::make_shared<el_text_run>(node->v.text.text, shared_from_this()));
 			}
 		}
 		break;
@@ -804,11 +979,7 @@ void litehtml::document::create_node(void* gnode, elements_list& elements, bool
 		break;
 	case GUMBO_NODE_WHITESPACE:
 		{
-			string str = node->v.text.text;
-			for (size_t i = 0; i < str.length(); i++)
-			{
-				elements.push_back(std::make_shared<el_space>(str.substr(i, 1).c_str(), shared_from_this()));
-			}
+			elements.push_back(std::make_shared<el_text_run>(node->v.text.text, shared_from_this()));
 		}
 		break;
 	default:
@@ -1026,6 +1197,10 @@ void litehtml::document::append_children_from_string(element& parent, const char
 	// Destroy GumboOutput
 	gumbo_destroy_output(&kGumboDefaultOptions, output);
 
+	// Children are styled below parent, whose chain seeds the ancestor filter
+	selector_filter filter;
+	filter.push_ancestors(parent.shared_from_this());
+
 	// Let's process created elements tree
 	for (const auto& child : child_elements)
 	{
@@ -1033,16 +1208,16 @@ void litehtml::document::append_children_from_string(element& parent, const char
 		parent.appendChild(child);
 
 		// apply master CSS
-		child->apply_stylesheet(m_master_css);
+		child->apply_stylesheet(*m_master_css, filter);
 
 		// parse elements attributes
 		child->parse_attributes();
 
 		// Apply parsed styles.
-		child->apply_stylesheet(m_styles);
+		child->apply_stylesheet(m_styles, filter);
 
 		// Apply user styles if any
-		child->apply_stylesheet(m_user_css);
+		child->apply_stylesheet(*m_user_css, filter);
 
 		// Initialize m_css
 		child->compute_styles();
@@ -4,6 +4,7 @@
 #include "style.h"
 #include "types.h"
 #include "master_css.h"
+#include <unordered_set>
 
 namespace litehtml
 {
@@ -56,18 +57,24 @@ namespace litehtml
 		std::shared_ptr<render_item>		m_root_render;
 		document_container*					m_container;
 		fonts_map							m_fonts;
+		std::unordered_map<string, uint32_t>	m_font_families;
 		css_text::vector					m_css;
 		litehtml::css						m_styles;
 		litehtml::web_color					m_def_color;
-        litehtml::css						m_master_css;
-        litehtml::css						m_user_css;
+		css::const_ptr						m_master_css;
+		css::const_ptr						m_user_css;
 		litehtml::size						m_size;
 		litehtml::size						m_content_size;
 		position::vector					m_fixed_boxes;
 		media_query_list::vector			m_media_lists;
 		element::ptr						m_over_element;
+		// Elements matched by rules using :hover or :active, the only ones mouse events can restyle
+		std::vector<element::weak_ptr>		m_state_dependent;
 		std::list<std::shared_ptr<render_item>>		m_tabular_elements;
+		int									m_render_width;
 		media_features						m_media;
+		// Set once a length in vw, vh, vmin or vmax was resolved against m_media
+		mutable bool						m_uses_viewport_units;
 		string								m_lang;
 		string								m_culture;
 	public:
@@ -75,7 +82,7 @@ namespace litehtml
 		virtual ~document();
 
 		document_container*				container()	{ return m_container; }
-		uint_ptr						get_font(const char* name, int size, const char* weight, const char* style, const char* decoration, font_metrics* fm);
+		uint_ptr						get_font(const string& name, int size, font_weight weight, font_style style, unsigned int decoration, font_metrics* fm);
 		int								render(int max_width, render_type rt = render_all);
 		void							draw(uint_ptr hdc, int x, int y, const position* clip);
 		web_color						get_def_color()	{ return m_def_color; }
@@ -86,16 +93,21 @@ namespace litehtml
 		int								height() const;
 		int								content_width() const;
 		int								content_height() const;
+		// max_width of the last full render
+		int								render_width() const { return m_render_width; }
 		void							add_stylesheet(const char* str, const char* baseurl, const char* media);
 		bool							on_mouse_over(int x, int y, int client_x, int client_y, position::vector& redraw_boxes);
 		bool							on_lbutton_down(int x, int y, int client_x, int client_y, position::vector& redraw_boxes);
 		bool							on_lbutton_up(int x, int y, int client_x, int client_y, position::vector& redraw_boxes);
 		bool							on_mouse_leave(position::vector& redraw_boxes);
+		// Lays out again what depends on the size of the given images, by their src as written in the document
+		bool							on_images_loaded(const string_vector& srcs, position::vector& redraw_boxes);
 		element::ptr					create_element(const char* tag_name, const string_map& attributes);
 		element::ptr					root();
 		void							get_fixed_boxes(position::vector& fixed_boxes);
 		void							add_fixed_box(const position& pos);
 		void							add_media_list(const media_query_list::ptr& list);
+		void							add_state_dependent(const element::ptr& el);
 		bool							media_changed();
 		bool							lang_changed();
 		bool							match_lang(const string& lang);
@@ -106,12 +118,20 @@ namespace litehtml
 		void							dump(dumper& cout);
 
 		static litehtml::document::ptr	createFromString(const char* str, litehtml::document_container* objPainter, const char* master_styles = litehtml::master_css, const char* user_styles = "");
+		// Same with stylesheets from css::create_shared(), which skips parsing them again for every document
+		static litehtml::document::ptr	createFromString(const char* str, litehtml::document_container* objPainter, const css::const_ptr& master_styles, const css::const_ptr& user_styles);
+		// Parses only the first length bytes of str, which need not be null terminated
+		static litehtml::document::ptr	createFromString(const char* str, size_t length, litehtml::document_container* objPainter, const css::const_ptr& master_styles, const css::const_ptr& user_styles);
 	
 	private:
-		uint_ptr	add_font(const char* name, int size, const char* weight, const char* style, const char* decoration, font_metrics* fm);
+		uint_ptr	add_font(const char* name, int size, font_weight weight, font_style style, unsigned int decoration, font_metrics* fm);
+		static uint64_t	font_key(uint32_t family, int size, font_weight weight, font_style style, unsigned int decoration);
 
 		void create_node(void* gnode, elements_list& elements, bool parseTextNode);
 		bool update_media_lists(const media_features& features);
+		bool find_state_changes(position::vector& redraw_boxes);
+		void update_media_dependent(const element::ptr& el, const media_query_list::vector& flipped, position::vector& redraw_boxes);
+		void find_image_boxes(const element::ptr& el, const std::unordered_set<string>& srcs, std::vector<std::shared_ptr<render_item>>& boxes, position::vector& redraw_boxes);
 		void fix_tables_layout();
 		void fix_table_children(const std::shared_ptr<render_item>& el_ptr, style_display disp, const char* disp_str);
 		void fix_table_parent(const std::shared_ptr<render_item> & el_ptr, style_display disp, const char* disp_str);
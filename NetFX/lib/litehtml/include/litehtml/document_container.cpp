@@ -3,42 +3,50 @@
 
 void litehtml::document_container::split_text(const char* text, const std::function<void(const char*)>& on_word, const std::function<void(const char*)>& on_space)
 {
-	std::wstring str;
-	std::wstring str_in = (const wchar_t*)utf8_to_wchar(text);
-	ucode_t c;
-	for (size_t i = 0; i < str_in.length(); i++)
+	if (!text) return;
+
+	std::vector<text_piece> pieces;
+	scan_utf8_text(text, strlen(text), pieces);
+
+	string word;
+	string single;
+	for (const auto& pc : pieces)
 	{
-		c = (ucode_t)str_in[i];
-		if (c <= ' ' && (c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f'))
+		switch (pc.cls)
 		{
-			if (!str.empty())
+		case text_piece_word:
+			word.append(text + pc.offset, pc.length);
+			break;
+		case text_piece_invalid:
+			word += '?';
+			break;
+		default:
+			if (!word.empty())
 			{
-				on_word(wchar_to_utf8(str.c_str()));
-				str.clear();
+				on_word(word.c_str());
+				word.clear();
 			}
-			str += c;
-			on_space(wchar_to_utf8(str.c_str()));
-			str.clear();
-		}
-		// CJK character range
-		else if (c >= 0x4E00 && c <= 0x9FCC)
-		{
-			if (!str.empty())
+			single.assign(text + pc.offset, pc.length);
+			if (pc.cls == text_piece_space)
+			{
+				on_space(single.c_str());
+			} else
 			{
-				on_word(wchar_to_utf8(str.c_str()));
-				str.clear();
+				on_word(single.c_str());
 			}
-			str += c;
-			on_word(wchar_to_utf8(str.c_str()));
-			str.clear();
-		}
-		else
-		{
-			str += c;
+			break;
 		}
 	}
-	if (!str.empty())
+	if (!word.empty())
+	{
+		on_word(word.c_str());
+	}
+}
+
+void litehtml::document_container::text_widths(const char* const* texts, int* widths, size_t count, uint_ptr hFont)
+{
+	for (size_t i = 0; i < count; i++)
 	{
-		on_word(wchar_to_utf8(str.c_str()));
+		widths[i] = text_width(texts[i], hFont);
 	}
 }
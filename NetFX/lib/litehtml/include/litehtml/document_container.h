@@ -62,6 +62,8 @@ namespace litehtml
 		virtual void				get_language(litehtml::string& language, litehtml::string& culture) const = 0;
 		virtual litehtml::string	resolve_color(const litehtml::string& /*color*/) const { return litehtml::string(); }
 		virtual void				split_text(const char* text, const std::function<void(const char*)>& on_word, const std::function<void(const char*)>& on_space);
+		// Measures count strings with one font; the default calls text_width for each
+		virtual void				text_widths(const char* const* texts, int* widths, size_t count, litehtml::uint_ptr hFont);
 
 	protected:
 		~document_container() = default;
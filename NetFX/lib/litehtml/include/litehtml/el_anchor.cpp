@@ -16,11 +16,11 @@ void litehtml::el_anchor::on_click()
 	}
 }
 
-void litehtml::el_anchor::apply_stylesheet( const litehtml::css& stylesheet )
+void litehtml::el_anchor::apply_stylesheet( const litehtml::css& stylesheet, selector_filter& filter )
 {
 	if( get_attr("href") )
 	{
 		m_pseudo_classes.push_back(_link_);
 	}
-	html_tag::apply_stylesheet(stylesheet);
+	html_tag::apply_stylesheet(stylesheet, filter);
 }
@@ -11,7 +11,7 @@ namespace litehtml
 		explicit el_anchor(const std::shared_ptr<litehtml::document>& doc);
 
 		void	on_click() override;
-		void	apply_stylesheet(const litehtml::css& stylesheet) override;
+		void	apply_stylesheet(const litehtml::css& stylesheet, selector_filter& filter) override;
 	};
 }
 
@@ -20,6 +20,19 @@ bool litehtml::el_image::is_replaced() const
 void litehtml::el_image::parse_attributes()
 {
 	m_src = get_attr("src", "");
+	if(m_src.empty())
+	{
+		// No src: fall back to the first srcset candidate, which is what a 1x display would pick
+		string srcset = get_attr("srcset", "");
+		size_t start = srcset.find_first_not_of(" \t\n\r\f,");
+		if(start != string::npos)
+		{
+			size_t end = srcset.find_first_of(" \t\n\r\f", start);
+			if(end == string::npos) end = srcset.size();
+			while(end > start && srcset[end - 1] == ',') end--;
+			m_src = srcset.substr(start, end - start);
+		}
+	}
 
 	const char* attr_height = get_attr("height");
 	if(attr_height)
@@ -12,6 +12,7 @@ namespace litehtml
 	public:
 		el_image(const document::ptr& doc);
 
+		const string&	get_src() const { return m_src; }
 		bool	is_replaced() const override;
 		void	parse_attributes() override;
 		void	compute_styles(bool recursive = true) override;
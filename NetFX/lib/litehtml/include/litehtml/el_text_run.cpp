@@ -0,0 +1,296 @@
+#include "html.h"
+#include "el_text_run.h"
+#include "render_text_run.h"
+
+litehtml::el_text_run::el_text_run(const char* text, const document::ptr& doc) : element(doc)
+{
+	m_height			= 0;
+	m_use_transformed	= false;
+	m_draw_spaces		= true;
+	m_all_spaces		= true;
+	css_w().set_display(display_inline_text);
+
+	if(!text) return;
+
+	size_t len = strlen(text);
+	std::vector<text_piece> scanned;
+	scanned.reserve(len / 4 + 1);
+	scan_utf8_text(text, len, scanned);
+
+	// Words are written straight into m_text; bytes that are not valid UTF-8
+	// become '?' like they did with utf8_to_wchar
+	m_text.reserve(len + len / 4);
+	size_t word_start = 0;
+	for(const auto& pc : scanned)
+	{
+		switch(pc.cls)
+		{
+		case text_piece_word:
+			m_text.append(text + pc.offset, pc.length);
+			break;
+		case text_piece_invalid:
+			m_text.push_back('?');
+			break;
+		default:
+			end_word(word_start);
+			add_piece(text + pc.offset, pc.length, pc.cls == text_piece_space);
+			word_start = m_text.size();
+			break;
+		}
+	}
+	end_word(word_start);
+
+	m_pieces.shrink_to_fit();
+	m_widths.assign(m_pieces.size(), 0);
+}
+
+void litehtml::el_text_run::end_word(size_t word_start)
+{
+	if(m_text.size() == word_start) return;
+
+	piece pc;
+	pc.offset	= (uint32_t) word_start;
+	pc.length	= (uint32_t) (m_text.size() - word_start);
+	pc.space	= 0;
+	m_pieces.push_back(pc);
+
+	m_text.push_back('\0');
+	m_all_spaces = false;
+}
+
+void litehtml::el_text_run::add_piece(const char* text, size_t length, bool space)
+{
+	if(!length) return;
+
+	piece pc;
+	pc.offset	= (uint32_t) m_text.size();
+	pc.length	= (uint32_t) length;
+	pc.space	= space ? 1 : 0;
+	m_pieces.push_back(pc);
+
+	m_text.append(text, length);
+	m_text.push_back('\0');
+
+	if(!space)
+	{
+		m_all_spaces = false;
+	}
+}
+
+bool litehtml::el_text_run::piece_is_white_space(size_t idx) const
+{
+	if(!m_pieces[idx].space) return false;
+
+	white_space ws = css().get_white_space();
+	return ws == white_space_normal || ws == white_space_nowrap || ws == white_space_pre_line;
+}
+
+bool litehtml::el_text_run::piece_is_break(size_t idx) const
+{
+	if(!m_pieces[idx].space || m_text[m_pieces[idx].offset] != '\n') return false;
+
+	white_space ws = css().get_white_space();
+	return ws == white_space_pre || ws == white_space_pre_line || ws == white_space_pre_wrap;
+}
+
+int litehtml::el_text_run::piece_height(size_t idx) const
+{
+	return piece_is_break(idx) ? 0 : m_height;
+}
+
+const char* litehtml::el_text_run::piece_text(size_t idx) const
+{
+	const piece& pc = m_pieces[idx];
+	if(pc.space)
+	{
+		if(piece_is_white_space(idx)) return " ";
+
+		char c = m_text[pc.offset];
+		if(c == '\t') return "    ";
+		if(c == '\n' || c == '\r') return "";
+	} else if(m_use_transformed)
+	{
+		return m_transformed_text.c_str() + m_transformed_offsets[idx];
+	}
+	return m_text.c_str() + pc.offset;
+}
+
+bool litehtml::el_text_run::is_white_space() const
+{
+	if(!m_all_spaces) return false;
+
+	white_space ws = css().get_white_space();
+	return ws == white_space_normal || ws == white_space_nowrap || ws == white_space_pre_line;
+}
+
+void litehtml::el_text_run::get_text(string& text)
+{
+	for(const auto& pc : m_pieces)
+	{
+		text.append(m_text, pc.offset, pc.length);
+	}
+}
+
+void litehtml::el_text_run::compute_styles(bool recursive)
+{
+	element::ptr el_parent = parent();
+	if (el_parent)
+	{
+		css_w().set_line_height(el_parent->css().get_line_height());
+		css_w().set_font(el_parent->css().get_font());
+		css_w().set_font_metrics(el_parent->css().get_font_metrics());
+		css_w().set_white_space(el_parent->css().get_white_space());
+		css_w().set_text_transform(el_parent->css().get_text_transform());
+	}
+	css_w().set_display(display_inline_text);
+	css_w().set_float(float_none);
+
+	document::ptr doc = get_document();
+
+	if(m_css.get_text_transform() != text_transform_none)
+	{
+		// Words are transformed one by one, so capitalization sees word boundaries
+		m_transformed_text.clear();
+		m_transformed_offsets.assign(m_pieces.size(), 0);
+		for(size_t i = 0; i < m_pieces.size(); i++)
+		{
+			if(m_pieces[i].space) continue;
+
+			string word(m_text, m_pieces[i].offset, m_pieces[i].length);
+			doc->container()->transform_text(word, m_css.get_text_transform());
+			m_transformed_offsets[i] = (uint32_t) m_transformed_text.size();
+			m_transformed_text += word;
+			m_transformed_text.push_back('\0');
+		}
+		m_use_transformed = true;
+	} else
+	{
+		m_transformed_text.clear();
+		m_transformed_offsets.clear();
+		m_use_transformed = false;
+	}
+
+	element::ptr p = parent();
+	while(p && p->css().get_display() == display_inline)
+	{
+		if(p->css().get_position() == element_position_relative)
+		{
+			css_w().set_offsets(p->css().get_offsets());
+			css_w().set_position(element_position_relative);
+			break;
+		}
+		p = p->parent();
+	}
+	if(p)
+	{
+		css_w().set_position(element_position_static);
+	}
+
+	font_metrics fm;
+	uint_ptr font = 0;
+	if (el_parent)
+	{
+		font = el_parent->css().get_font();
+		fm = el_parent->css().get_font_metrics();
+	}
+	m_draw_spaces = fm.draw_spaces;
+	m_height = font ? fm.height : 0;
+
+	m_widths.assign(m_pieces.size(), 0);
+	if(!font) return;
+
+	// The whole run is measured in one call; collapsed spaces all look the same,
+	// so " " is measured once and shared
+	std::vector<const char*> texts;
+	std::vector<uint32_t> indexes;
+	texts.reserve(m_pieces.size() + 1);
+	indexes.reserve(m_pieces.size() + 1);
+
+	bool has_white_space = false;
+	for(size_t i = 0; i < m_pieces.size(); i++)
+	{
+		if(piece_is_break(i)) continue;
+
+		if(piece_is_white_space(i))
+		{
+			has_white_space = true;
+		} else
+		{
+			texts.push_back(piece_text(i));
+			indexes.push_back((uint32_t) i);
+		}
+	}
+	if(has_white_space)
+	{
+		texts.push_back(" ");
+	}
+
+	std::vector<int> widths(texts.size());
+	doc->container()->text_widths(texts.data(), widths.data(), texts.size(), font);
+
+	for(size_t i = 0; i < indexes.size(); i++)
+	{
+		m_widths[indexes[i]] = widths[i];
+	}
+	if(has_white_space)
+	{
+		int space_width = widths.back();
+		for(size_t i = 0; i < m_pieces.size(); i++)
+		{
+			if(piece_is_white_space(i))
+			{
+				m_widths[i] = space_width;
+			}
+		}
+	}
+}
+
+void litehtml::el_text_run::draw(uint_ptr hdc, int x, int y, const position *clip, const std::shared_ptr<render_item> &ri)
+{
+	element::ptr el_parent = parent();
+	if (!el_parent) return;
+
+	uint_ptr font = el_parent->css().get_font();
+	if(!font) return;
+
+	auto run = std::static_pointer_cast<render_item_text_run>(ri);
+	document::ptr doc = get_document();
+	web_color color = el_parent->css().get_color();
+
+	for(size_t i = 0; i < m_pieces.size(); i++)
+	{
+		if(run->piece_skip(i)) continue;
+		if(piece_is_white_space(i) && !m_draw_spaces) continue;
+
+		const char* text = piece_text(i);
+		if(!text[0]) continue;
+
+		position pos = run->piece_pos(i);
+		pos.x	+= x;
+		pos.y	+= y;
+
+		if(pos.does_intersect(clip))
+		{
+			doc->container()->draw_text(hdc, text, font, color, pos);
+		}
+	}
+}
+
+std::shared_ptr<litehtml::render_item> litehtml::el_text_run::create_render_item(const std::shared_ptr<render_item>& parent_ri)
+{
+	auto ret = std::make_shared<render_item_text_run>(shared_from_this());
+	ret->parent(parent_ri);
+	return ret;
+}
+
+litehtml::string litehtml::el_text_run::dump_get_name()
+{
+	string text;
+	get_text(text);
+	return "text run: \"" + get_escaped_string(text) + "\"";
+}
+
+std::vector<std::tuple<litehtml::string, litehtml::string>> litehtml::el_text_run::dump_get_attrs()
+{
+	return std::vector<std::tuple<string, string>>();
+}
@@ -0,0 +1,60 @@
+#ifndef LH_EL_TEXT_RUN_H
+#define LH_EL_TEXT_RUN_H
+
+#include "html_tag.h"
+
+namespace litehtml
+{
+	/**
+	 * A whole text node stored as one element. Words and white space characters are
+	 * pieces of the run instead of separate el_text/el_space elements; line layout
+	 * places the pieces directly (see lbi_text_piece).
+	 */
+	class el_text_run : public element
+	{
+	public:
+		struct piece
+		{
+			uint32_t	offset;			// into m_text, every piece is NUL terminated
+			uint32_t	length : 31;
+			uint32_t	space : 1;		// a single white space character
+		};
+	protected:
+		string					m_text;
+		string					m_transformed_text;
+		std::vector<piece>		m_pieces;
+		std::vector<uint32_t>	m_transformed_offsets;
+		std::vector<int>		m_widths;
+		int						m_height;
+		bool					m_use_transformed;
+		bool					m_draw_spaces;
+		bool					m_all_spaces;
+
+		void				add_piece(const char* text, size_t length, bool space);
+		void				end_word(size_t word_start);
+	public:
+		el_text_run(const char* text, const document::ptr& doc);
+
+		size_t				pieces_count() const { return m_pieces.size(); }
+		bool				piece_is_space(size_t idx) const { return m_pieces[idx].space; }
+		bool				piece_is_white_space(size_t idx) const;
+		bool				piece_is_break(size_t idx) const;
+		int					piece_width(size_t idx) const { return m_widths[idx]; }
+		int					piece_height(size_t idx) const;
+		const char*			piece_text(size_t idx) const;
+
+		void				get_text(string& text) override;
+		void				compute_styles(bool recursive) override;
+		bool				is_text() const override { return true; }
+		bool				is_text_run() const override { return true; }
+		bool				is_white_space() const override;
+		bool				is_space() const override { return m_all_spaces; }
+
+		void				draw(uint_ptr hdc, int x, int y, const position *clip, const std::shared_ptr<render_item> &ri) override;
+		std::shared_ptr<render_item> create_render_item(const std::shared_ptr<render_item>& parent_ri) override;
+		string				dump_get_name() override;
+		std::vector<std::tuple<string, string>> dump_get_attrs() override;
+	};
+}
+
+#endif  // LH_EL_TEXT_RUN_H
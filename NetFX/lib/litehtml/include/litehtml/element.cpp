@@ -220,40 +220,68 @@ bool element::find_styles_changes( position::vector& redraw_boxes)
 
 	if(requires_styles_update())
 	{
-		auto fetch_boxes = [&](const std::shared_ptr<element>& el)
+		update_styles(redraw_boxes);
+		ret = true;
+	}
+	for (auto& el : m_children)
+	{
+		if(el->find_styles_changes(redraw_boxes))
+		{
+			ret = true;
+		}
+	}
+	return ret;
+}
+
+void element::update_styles( position::vector& redraw_boxes)
+{
+	auto fetch_boxes = [&](const std::shared_ptr<element>& el)
+		{
+			for(const auto& weak_ri : el->m_renders)
 			{
-				for(const auto& weak_ri : el->m_renders)
+				auto ri = weak_ri.lock();
+				if(ri)
 				{
-					auto ri = weak_ri.lock();
-					if(ri)
+					position::vector boxes;
+					ri->get_rendering_boxes(boxes);
+					for (auto &box: boxes)
 					{
-						position::vector boxes;
-						ri->get_rendering_boxes(boxes);
-						for (auto &box: boxes)
-						{
-							redraw_boxes.push_back(box);
-						}
+						redraw_boxes.push_back(box);
 					}
 				}
-			};
-		fetch_boxes(shared_from_this());
-		for (auto& el : m_children)
+			}
+		};
+	fetch_boxes(shared_from_this());
+	for (auto& el : m_children)
+	{
+		fetch_boxes(el);
+	}
+
+	refresh_styles();
+	compute_styles();
+
+	// Boxes of the subtree may change size with the new styles
+	for(const auto& weak_ri : m_renders)
+	{
+		auto ri = weak_ri.lock();
+		if(ri)
 		{
-			fetch_boxes(el);
+			ri->invalidate_layout();
 		}
-
-		refresh_styles();
-		compute_styles();
-		ret = true;
 	}
-	for (auto& el : m_children)
+}
+
+bool element::depends_on_media( const media_query_list::vector& lists ) const
+{
+	for (const auto& used_style : m_used_styles)
 	{
-		if(el->find_styles_changes(redraw_boxes))
+		const auto& media = used_style->m_selector->m_media_query;
+		if(media && std::find(lists.begin(), lists.end(), media) != lists.end())
 		{
-			ret = true;
+			return true;
 		}
 	}
-	return ret;
+	return false;
 }
 
 element::ptr element::_add_before_after(int type, const style& style)
@@ -436,7 +464,7 @@ const char* element::get_tagName() const							LITEHTML_RETURN_FUNC("")
 void element::set_tagName( const char* tag )						LITEHTML_EMPTY_FUNC
 void element::set_data( const char* data )							LITEHTML_EMPTY_FUNC
 void element::set_attr( const char* name, const char* val )			LITEHTML_EMPTY_FUNC
-void element::apply_stylesheet( const litehtml::css& stylesheet )	LITEHTML_EMPTY_FUNC
+void element::apply_stylesheet( const litehtml::css& stylesheet, selector_filter& filter )	LITEHTML_EMPTY_FUNC
 void element::refresh_styles()										LITEHTML_EMPTY_FUNC
 void element::on_click()											LITEHTML_EMPTY_FUNC
 void element::compute_styles( bool recursive )						LITEHTML_EMPTY_FUNC
@@ -447,6 +475,7 @@ bool element::is_comment() const									LITEHTML_RETURN_FUNC(false)
 bool element::is_body() const										LITEHTML_RETURN_FUNC(false)
 bool element::is_break() const										LITEHTML_RETURN_FUNC(false)
 bool element::is_text() const										LITEHTML_RETURN_FUNC(false)
+bool element::is_text_run() const									LITEHTML_RETURN_FUNC(false)
 
 bool element::on_mouse_over()										LITEHTML_RETURN_FUNC(false)
 bool element::on_mouse_leave()										LITEHTML_RETURN_FUNC(false)
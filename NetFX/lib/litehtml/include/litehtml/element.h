@@ -82,7 +82,7 @@ namespace litehtml
 
 		virtual void				set_attr(const char* name, const char* val);
 		virtual const char*			get_attr(const char* name, const char* def = nullptr) const;
-		virtual void				apply_stylesheet(const litehtml::css& stylesheet);
+		virtual void				apply_stylesheet(const litehtml::css& stylesheet, selector_filter& filter);
 		virtual void				refresh_styles();
 		virtual bool				is_white_space() const;
 		virtual bool				is_space() const;
@@ -90,6 +90,7 @@ namespace litehtml
 		virtual bool				is_body() const;
 		virtual bool				is_break() const;
 		virtual bool				is_text() const;
+		virtual bool				is_text_run() const;
 
 		virtual bool				on_mouse_over();
 		virtual bool				on_mouse_leave();
@@ -139,6 +140,9 @@ namespace litehtml
 		bool requires_styles_update();
 		void add_render(const std::shared_ptr<render_item>& ri);
 		bool find_styles_changes( position::vector& redraw_boxes);
+		void update_styles( position::vector& redraw_boxes);
+		// Whether a rule this element matched applies only under one of the given media lists
+		bool depends_on_media( const media_query_list::vector& lists ) const;
 		element::ptr add_pseudo_before(const style& style)
 		{
 			return _add_before_after(0, style);
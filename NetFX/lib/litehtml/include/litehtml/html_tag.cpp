@@ -10,6 +10,7 @@
 #include "num_cvt.h"
 #include "line_box.h"
 #include <stack>
+#include <typeinfo>
 #include "render_item.h"
 
 litehtml::html_tag::html_tag(const std::shared_ptr<document>& doc) : element(doc)
@@ -176,34 +177,118 @@ litehtml::element::ptr litehtml::html_tag::select_one( const css_selector& selec
 	return nullptr;
 }
 
-void litehtml::html_tag::apply_stylesheet( const litehtml::css& stylesheet )
+void litehtml::html_tag::apply_stylesheet( const litehtml::css& stylesheet, selector_filter& filter )
 {
 	if(is_root())
 	{
 		int i = 0;
 		i++;
 	}
-	for(const auto& sel : stylesheet.selectors())
+
+	// Siblings styled in full earlier in this pass may already have matched exactly the same rules
+	auto parent_tag = dynamic_cast<html_tag*>(parent().get());
+	html_tag* source = parent_tag ? parent_tag->find_style_source(*this, stylesheet) : nullptr;
+	if(source)
 	{
-		// optimization
+		share_matched_styles(*source);
+
+		// The computed style can only be copied too if every stylesheet came from the same element
+		if(!m_style_unshared && (!m_style_source || m_style_source == source))
 		{
-			const auto& r = sel->m_right;
-			if (r.m_tag != star_id && r.m_tag != m_tag)
-				continue;
+			m_style_source = source;
+		} else
+		{
+			m_style_source = nullptr;
+			m_style_unshared = true;
+		}
+		m_matched_css = nullptr;
+	} else
+	{
+		match_stylesheet(stylesheet, filter);
+		m_style_source = nullptr;
+		m_style_unshared = true;
+	}
+
+	filter.push(m_tag, m_id, m_classes);
+	m_sharing_candidates.clear();
+	for(auto& el : m_children)
+	{
+		if(el->css().get_display() != display_inline_text)
+		{
+			el->apply_stylesheet(stylesheet, filter);
 
-			if (!r.m_attrs.empty())
+			// Children matched in full are offered to the siblings after them
+			auto child = dynamic_cast<html_tag*>(el.get());
+			if(child && child->m_matched_css == &stylesheet)
 			{
-				const auto& attr = r.m_attrs[0];
-				if (attr.type == select_class &&
-					std::find(m_classes.begin(), m_classes.end(), attr.name) == m_classes.end())
-					continue;
+				if(m_sharing_candidates.size() >= max_sharing_candidates)
+				{
+					m_sharing_candidates.erase(m_sharing_candidates.begin());
+				}
+				m_sharing_candidates.push_back(child);
 			}
 		}
+	}
+	m_sharing_candidates.clear();
+	filter.pop(m_tag, m_id, m_classes);
+}
+
+void litehtml::html_tag::match_stylesheet( const litehtml::css& stylesheet, const selector_filter& filter )
+{
+	// Elements with an id are unique by definition and never worth sharing with
+	bool shareable = m_id == empty_id;
+	bool cousins_shareable = shareable;
+	bool state_dependent = false;
+	size_t matched_begin = m_used_styles.size();
+	const auto& selectors = stylesheet.selectors();
+
+	// Only the rules whose rightmost id, class or tag can match this element
+	std::vector<int> candidates;
+	if(stylesheet.is_indexed())
+	{
+		stylesheet.get_candidates(m_tag, m_id, m_classes, candidates);
+	} else
+	{
+		candidates.resize(selectors.size());
+		for(int i = 0; i < (int) selectors.size(); i++)
+		{
+			candidates[i] = i;
+		}
+	}
+
+	for(int index : candidates)
+	{
+		const auto& sel = selectors[index];
+
+		// Rules needing an ancestor this element cannot have are dropped without walking the parents
+		if(!filter.may_match(*sel))
+		{
+			continue;
+		}
+
+		if(sel->m_position_sensitive)
+		{
+			shareable = false;
+		}
+		if(sel->m_ancestors_position_sensitive)
+		{
+			cousins_shareable = false;
+		}
 
 		int apply = select(*sel, false);
 
 		if(apply != select_no_match)
 		{
+			if(apply & (select_match_with_after | select_match_with_before))
+			{
+				shareable = false;
+			}
+
+			if(sel->m_state_sensitive)
+			{
+				state_dependent = true;
+			}
+
 			used_selector::ptr us = std::unique_ptr<used_selector>(new used_selector(sel, false));
 
 			if(sel->is_media_valid())
@@ -271,11 +356,89 @@ void litehtml::html_tag::apply_stylesheet( const litehtml::css& stylesheet )
 		}
 	}
 
-	for(auto& el : m_children)
+	m_matched_css		= shareable ? &stylesheet : nullptr;
+	m_matched_begin		= matched_begin;
+	m_matched_cousins	= shareable && cousins_shareable;
+
+	if(state_dependent)
 	{
-		if(el->css().get_display() != display_inline_text)
+		mark_state_dependent();
+	}
+}
+
+litehtml::html_tag* litehtml::html_tag::find_style_source( const html_tag& el, const litehtml::css& stylesheet ) const
+{
+	// Most recent first, runs of identical siblings usually sit next to each other
+	for(auto it = m_sharing_candidates.rbegin(); it != m_sharing_candidates.rend(); ++it)
+	{
+		html_tag* candidate = *it;
+		if(el.can_share_style(*candidate))
+		{
+			return candidate;
+		}
+	}
+
+	// Children of the element this one shares with are cousins that inherit the same values
+	if(m_style_source)
+	{
+		size_t checked = 0;
+		for(const auto& child : m_style_source->m_children)
 		{
-			el->apply_stylesheet(stylesheet);
+			auto candidate = dynamic_cast<html_tag*>(child.get());
+			if(!candidate)
+			{
+				continue;
+			}
+			if(candidate->m_matched_css == &stylesheet && candidate->m_matched_cousins && el.can_share_style(*candidate))
+			{
+				return candidate;
+			}
+			if(++checked >= max_sharing_candidates)
+			{
+				break;
+			}
+		}
+	}
+	return nullptr;
+}
+
+bool litehtml::html_tag::can_share_style( const html_tag& other ) const
+{
+	// Attributes cover attribute selectors, presentational hints and the style attribute
+	return typeid(*this) == typeid(other) &&
+		m_tag == other.m_tag &&
+		m_id == empty_id &&
+		m_classes == other.m_classes &&
+		m_pseudo_classes == other.m_pseudo_classes &&
+		m_attrs == other.m_attrs;
+}
+
+void litehtml::html_tag::share_matched_styles( const html_tag& source )
+{
+	for(size_t i = source.m_matched_begin; i < source.m_used_styles.size(); i++)
+	{
+		const auto& usel = source.m_used_styles[i];
+		if(usel->m_used)
+		{
+			add_style(*usel->m_selector->m_style);
+		}
+		m_used_styles.push_back(std::unique_ptr<used_selector>(new used_selector(usel->m_selector, usel->m_used)));
+		if(usel->m_selector->m_state_sensitive)
+		{
+			mark_state_dependent();
+		}
+	}
+}
+
+void litehtml::html_tag::mark_state_dependent()
+{
+	if(!m_state_dependent)
+	{
+		m_state_dependent = true;
+		auto doc = get_document();
+		if(doc)
+		{
+			doc->add_state_dependent(shared_from_this());
 		}
 	}
 }
@@ -424,7 +587,16 @@ void litehtml::html_tag::compute_styles(bool recursive)
 
 	m_style.subst_vars(this);
 
-	m_css.compute(this, doc);
+	// A sibling or cousin that matched the same rules in every stylesheet has already computed the same values
+	if(m_style_source)
+	{
+		m_css = m_style_source->m_css;
+	} else
+	{
+		m_css.compute(this, doc);
+	}
+	m_style_source = nullptr;
+	m_style_unshared = false;
 
 	if (recursive)
 	{
@@ -31,6 +31,18 @@ namespace litehtml
 		string_map				m_attrs;
 		std::vector<string_id>	m_pseudo_classes;
 
+		// Style sharing between siblings and cousins, see apply_stylesheet()
+		static const size_t		max_sharing_candidates = 8;
+		std::vector<html_tag*>	m_sharing_candidates;		// Children matched in full in the current pass
+		const litehtml::css*	m_matched_css		= nullptr;	// Stylesheet of the last full match, if shareable
+		size_t					m_matched_begin		= 0;		// First m_used_styles entry it added
+		bool					m_matched_cousins	= false;	// Whether cousins may share that match too
+		html_tag*				m_style_source		= nullptr;	// Element every pass so far was shared with
+		bool					m_style_unshared	= false;
+
+		// Registered with the document as needing a restyle check on :hover and :active changes
+		bool					m_state_dependent	= false;
+
 		void			select_all(const css_selector& selector, elements_list& res) override;
 
 	public:
@@ -49,7 +61,7 @@ namespace litehtml
 
 		void				set_attr(const char* name, const char* val) override;
 		const char*			get_attr(const char* name, const char* def = nullptr) const override;
-		void				apply_stylesheet(const litehtml::css& stylesheet) override;
+		void				apply_stylesheet(const litehtml::css& stylesheet, selector_filter& filter) override;
 		void				refresh_styles() override;
 
 		bool				is_white_space() const override;
@@ -123,6 +135,11 @@ namespace litehtml
 
 	private:
 		void				handle_counter_properties();
+		void				match_stylesheet(const litehtml::css& stylesheet, const selector_filter& filter);
+		html_tag*			find_style_source(const html_tag& el, const litehtml::css& stylesheet) const;
+		bool				can_share_style(const html_tag& other) const;
+		void				share_matched_styles(const html_tag& source);
+		void				mark_state_dependent();
 
 	};
 
@@ -2,6 +2,7 @@
 #include "line_box.h"
 #include "element.h"
 #include "render_item.h"
+#include "render_text_run.h"
 #include <algorithm>
 
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -43,6 +44,147 @@ int litehtml::line_box_item::left() const
 	return m_element->left();
 }
 
+int litehtml::line_box_item::height() const
+{
+	return m_element->height();
+}
+
+bool litehtml::line_box_item::is_white_space() const
+{
+	return m_element->src_el()->is_white_space();
+}
+
+bool litehtml::line_box_item::is_space() const
+{
+	return m_element->src_el()->is_space();
+}
+
+bool litehtml::line_box_item::is_break() const
+{
+	return m_element->src_el()->is_break();
+}
+
+bool litehtml::line_box_item::skip() const
+{
+	return m_element->skip();
+}
+
+void litehtml::line_box_item::skip(bool val)
+{
+	m_element->skip(val);
+}
+
+void litehtml::line_box_item::apply_relative_shift(const containing_block_context &containing_block_size)
+{
+	m_element->apply_relative_shift(containing_block_size);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+litehtml::lbi_text_piece::lbi_text_piece(const std::shared_ptr<render_item_text_run>& run, size_t index) :
+	line_box_item(run),
+	m_run(run.get()),
+	m_text(static_cast<el_text_run*>(run->src_el().get())),
+	m_index(index)
+{
+	position& pp = m_run->piece_pos(m_index);
+	pp.width	= m_text->piece_width(m_index);
+	pp.height	= m_text->piece_height(m_index);
+	m_rendered_min_width = pp.width;
+}
+
+litehtml::position& litehtml::lbi_text_piece::pos()
+{
+	return m_run->piece_pos(m_index);
+}
+
+void litehtml::lbi_text_piece::place_to(int x, int y)
+{
+	position& pp = m_run->piece_pos(m_index);
+	pp.x = x;
+	pp.y = y;
+}
+
+int litehtml::lbi_text_piece::width() const
+{
+	return m_run->piece_pos(m_index).width;
+}
+
+int litehtml::lbi_text_piece::height() const
+{
+	return m_run->piece_pos(m_index).height;
+}
+
+int litehtml::lbi_text_piece::top() const
+{
+	return m_run->piece_pos(m_index).top();
+}
+
+int litehtml::lbi_text_piece::bottom() const
+{
+	return m_run->piece_pos(m_index).bottom();
+}
+
+int litehtml::lbi_text_piece::right() const
+{
+	return m_run->piece_pos(m_index).right();
+}
+
+int litehtml::lbi_text_piece::left() const
+{
+	return m_run->piece_pos(m_index).left();
+}
+
+bool litehtml::lbi_text_piece::is_white_space() const
+{
+	return m_text->piece_is_white_space(m_index);
+}
+
+bool litehtml::lbi_text_piece::is_space() const
+{
+	return m_text->piece_is_space(m_index);
+}
+
+bool litehtml::lbi_text_piece::is_break() const
+{
+	return m_text->piece_is_break(m_index);
+}
+
+bool litehtml::lbi_text_piece::skip() const
+{
+	return m_run->piece_skip(m_index);
+}
+
+void litehtml::lbi_text_piece::skip(bool val)
+{
+	m_run->piece_skip(m_index, val);
+}
+
+void litehtml::lbi_text_piece::apply_relative_shift(const containing_block_context &containing_block_size)
+{
+	if (m_text->css().get_position() == element_position_relative)
+	{
+		css_offsets offsets = m_text->css().get_offsets();
+		position& pp = m_run->piece_pos(m_index);
+		if (!offsets.left.is_predefined())
+		{
+			pp.x += offsets.left.calc_percent(containing_block_size.width);
+		}
+		else if (!offsets.right.is_predefined())
+		{
+			pp.x -= offsets.right.calc_percent(containing_block_size.width);
+		}
+		if (!offsets.top.is_predefined())
+		{
+			pp.y += offsets.top.calc_percent(containing_block_size.height);
+		}
+		else if (!offsets.bottom.is_predefined())
+		{
+			pp.y -= offsets.bottom.calc_percent(containing_block_size.height);
+		}
+	}
+}
+
 //////////////////////////////////////////////////////////////////////////////////////////
 
 litehtml::lbi_start::lbi_start(const std::shared_ptr<render_item>& element) : line_box_item(element)
@@ -139,12 +281,12 @@ int litehtml::lbi_continue::width() const
 
 void litehtml::line_box::add_item(std::unique_ptr<line_box_item> item)
 {
-    item->get_el()->skip(false);
+    item->skip(false);
     bool add	= true;
 	switch (item->get_type())
 	{
 		case line_box_item::type_text_part:
-			if(item->get_el()->src_el()->is_white_space())
+			if(item->is_white_space())
 			{
 				add = !is_empty() && !have_last_space();
 			}
@@ -159,11 +301,11 @@ void litehtml::line_box::add_item(std::unique_ptr<line_box_item> item)
 	{
 		item->place_to(m_left + m_width, m_top);
 		m_width += item->width();
-		m_height = std::max(m_height, item->get_el()->height());
+		m_height = std::max(m_height, item->height());
 		m_items.emplace_back(std::move(item));
 	} else
 	{
-		item->get_el()->skip(true);
+		item->skip(true);
 	}
 }
 
@@ -202,11 +344,11 @@ std::list< std::unique_ptr<litehtml::line_box_item> > litehtml::line_box::finish
 			if (m_items.back()->get_type() == line_box_item::type_text_part)
 			{
 				// remove trailing spaces
-				if (m_items.back()->get_el()->src_el()->is_break() ||
-					m_items.back()->get_el()->src_el()->is_white_space())
+				if (m_items.back()->is_break() ||
+					m_items.back()->is_white_space())
 				{
 					m_width -= m_items.back()->width();
-					m_items.back()->get_el()->skip(true);
+					m_items.back()->skip(true);
 					m_items.pop_back();
 				} else
 				{
@@ -232,9 +374,9 @@ std::list< std::unique_ptr<litehtml::line_box_item> > litehtml::line_box::finish
 		{
 			if ((*iter)->get_type() == line_box_item::type_text_part)
 			{
-				if((*iter)->get_el()->src_el()->is_white_space())
+				if((*iter)->is_white_space())
 				{
-					(*iter)->get_el()->skip(true);
+					(*iter)->skip(true);
 					m_width -= (*iter)->width();
 					// Space can be between text and inline_end marker
 					// We have to shift all items on the right side
@@ -488,7 +630,7 @@ std::list< std::unique_ptr<litehtml::line_box_item> > litehtml::line_box::finish
 				lbi->pos().y = m_top + m_height - lbi->get_el()->height() + lbi->get_el()->content_offset_top();
 			}
         }
-        lbi->get_el()->apply_relative_shift(containing_block_size);
+        lbi->apply_relative_shift(containing_block_size);
 
 		// Calculate and push inline box into the render item element
 		if(lbi->get_type() == line_box_item::type_inline_start || lbi->get_type() == line_box_item::type_inline_continue)
@@ -549,6 +691,18 @@ std::shared_ptr<litehtml::render_item> litehtml::line_box::get_last_text_part()
 }
 
 
+const litehtml::line_box_item* litehtml::line_box::get_last_text_item() const
+{
+	for(auto iter = m_items.rbegin(); iter != m_items.rend(); iter++)
+	{
+		if((*iter)->get_type() == line_box_item::type_text_part)
+		{
+			return iter->get();
+		}
+	}
+	return nullptr;
+}
+
 bool litehtml::line_box::can_hold(const std::unique_ptr<line_box_item>& item, white_space ws) const
 {
     if(!item->get_el()->src_el()->is_inline()) return false;
@@ -556,34 +710,34 @@ bool litehtml::line_box::can_hold(const std::unique_ptr<line_box_item>& item, wh
 	if(item->get_type() == line_box_item::type_text_part)
 	{
 		// force new line on floats clearing
-		if (item->get_el()->src_el()->is_break() && item->get_el()->src_el()->css().get_clear() != clear_none)
+		if (item->is_break() && item->get_el()->src_el()->css().get_clear() != clear_none)
 		{
 			return false;
 		}
 
-		auto last_el = get_last_text_part();
+		auto last_item = get_last_text_item();
 
 		// the first word is always can be hold
-		if(!last_el)
+		if(!last_item)
 		{
 			return true;
 		}
 
 		// force new line if the last placed element was line break
 		// Skip If there are the only break item - this is float clearing
-		if (last_el && last_el->src_el()->is_break() && m_items.size() > 1)
+		if (last_item->is_break() && m_items.size() > 1)
 		{
 			return false;
 		}
 
 		// line break should stay in current line box
-		if (item->get_el()->src_el()->is_break())
+		if (item->is_break())
 		{
 			return true;
 		}
 
 		if (ws == white_space_nowrap || ws == white_space_pre ||
-			(ws == white_space_pre_wrap && item->get_el()->src_el()->is_space()))
+			(ws == white_space_pre_wrap && item->is_space()))
 		{
 			return true;
 		}
@@ -599,10 +753,10 @@ bool litehtml::line_box::can_hold(const std::unique_ptr<line_box_item>& item, wh
 
 bool litehtml::line_box::have_last_space()  const
 {
-	auto last_el = get_last_text_part();
-	if(last_el)
+	auto last_item = get_last_text_item();
+	if(last_item)
 	{
-		return last_el->src_el()->is_white_space() || last_el->src_el()->is_break();
+		return last_item->is_white_space() || last_item->is_break();
 	}
 	return false;
 }
@@ -611,7 +765,7 @@ bool litehtml::line_box::is_empty() const
 {
     if(m_items.empty()) return true;
 	if(m_items.size() == 1 &&
-		m_items.front()->get_el()->src_el()->is_break() &&
+		m_items.front()->is_break() &&
 		m_items.front()->get_el()->src_el()->css().get_clear() != clear_none)
 	{
 		return true;
@@ -620,7 +774,7 @@ bool litehtml::line_box::is_empty() const
     {
 		if(el->get_type() == line_box_item::type_text_part)
 		{
-			if (!el->get_el()->skip() || el->get_el()->src_el()->is_break())
+			if (!el->skip() || el->is_break())
 			{
 				return false;
 			}
@@ -663,10 +817,10 @@ bool litehtml::line_box::is_break_only() const
 	{
 		if((*iter)->get_type() == line_box_item::type_text_part)
 		{
-			if((*iter)->get_el()->src_el()->is_break())
+			if((*iter)->is_break())
 			{
 				break_found = true;
-			} else if(!(*iter)->get_el()->skip())
+			} else if(!(*iter)->skip())
 			{
 				return false;
 			}
@@ -689,7 +843,7 @@ std::list< std::unique_ptr<litehtml::line_box_item> > litehtml::line_box::new_wi
 		i++;
 		while (i != m_items.end())
         {
-            if(!(*i)->get_el()->skip())
+            if(!(*i)->skip())
             {
                 if(m_left + m_width + (*i)->width() > m_right)
                 {
@@ -698,7 +852,7 @@ std::list< std::unique_ptr<litehtml::line_box_item> > litehtml::line_box::new_wi
                 } else
                 {
 					(*i)->pos().x += add;
-                    m_width += (*i)->get_el()->width();
+                    m_width += (*i)->width();
                 }
             }
 			i++;
@@ -9,6 +9,8 @@
 namespace litehtml
 {
     class render_item;
+    class render_item_text_run;
+    class el_text_run;
 
     struct line_context
     {
@@ -46,7 +48,7 @@ namespace litehtml
 		line_box_item(const line_box_item& el) = default;
 		line_box_item(line_box_item&&) = default;
 
-		int height() const { return right() - left(); }
+		virtual int height() const;
 		const std::shared_ptr<render_item>& get_el() const { return m_element; }
 		virtual position& pos();
 		virtual void place_to(int x, int y);
@@ -58,6 +60,44 @@ namespace litehtml
 		virtual element_type get_type() const	{ return type_text_part; }
 		virtual int get_rendered_min_width() const	{ return m_rendered_min_width; }
 		virtual void set_rendered_min_width(int min_width)	{ m_rendered_min_width = min_width; }
+		virtual bool is_white_space() const;
+		virtual bool is_space() const;
+		virtual bool is_break() const;
+		virtual bool skip() const;
+		virtual void skip(bool val);
+		virtual void apply_relative_shift(const containing_block_context &containing_block_size);
+		// true if the item was measured when it was created
+		virtual bool is_text_piece() const	{ return false; }
+	};
+
+	/**
+	 * One word or white space character of an el_text_run. The position lives in the
+	 * run's render item, so the run can draw every piece wherever it was placed.
+	 */
+	class lbi_text_piece : public line_box_item
+	{
+	protected:
+		render_item_text_run*	m_run;
+		el_text_run*			m_text;
+		size_t					m_index;
+	public:
+		lbi_text_piece(const std::shared_ptr<render_item_text_run>& run, size_t index);
+
+		position& pos() override;
+		void place_to(int x, int y) override;
+		int width() const override;
+		int height() const override;
+		int top() const override;
+		int bottom() const override;
+		int right() const override;
+		int left() const override;
+		bool is_white_space() const override;
+		bool is_space() const override;
+		bool is_break() const override;
+		bool skip() const override;
+		void skip(bool val) override;
+		void apply_relative_shift(const containing_block_context &containing_block_size) override;
+		bool is_text_piece() const override	{ return true; }
 	};
 
 	class lbi_start : public line_box_item
@@ -161,6 +201,7 @@ namespace litehtml
 		std::shared_ptr<render_item> 		get_first_text_part() const;
 		std::list< std::unique_ptr<line_box_item> >& 	items() { return m_items; }
 	private:
+		const line_box_item*	get_last_text_item() const;
         bool				have_last_space() const;
         bool				is_break_only() const;
 		static int			calc_va_baseline(const va_context& current, vertical_align va, const font_metrics& new_font, int top, int bottom);
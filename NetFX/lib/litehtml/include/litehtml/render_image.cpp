@@ -15,6 +15,7 @@ int litehtml::render_item_image::_render(int x, int y, const containing_block_co
 
     litehtml::size sz;
     src_el()->get_content_size(sz, containing_block_size.width);
+    m_image_size = sz;
 
     m_pos.width		= sz.width;
     m_pos.height	= sz.height;
@@ -146,3 +147,21 @@ int litehtml::render_item_image::calc_max_height(int image_height, int containin
     return doc->to_pixels(src_el()->css().get_max_height(), src_el()->css().get_font_size(),
 						  containing_block_height == 0 ? image_height : containing_block_height);
 }
+
+bool litehtml::render_item_image::intrinsic_size_changed()
+{
+	if(!m_laid_out)
+	{
+		return false;
+	}
+
+	// With both dimensions given the image is scaled into them whatever its size
+	if(!src_el()->css().get_width().is_predefined() && !src_el()->css().get_height().is_predefined())
+	{
+		return false;
+	}
+
+	litehtml::size sz;
+	src_el()->get_content_size(sz, m_layout_cb.width);
+	return sz.width != m_image_size.width || sz.height != m_image_size.height;
+}
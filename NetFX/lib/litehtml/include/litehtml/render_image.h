@@ -8,6 +8,8 @@ namespace litehtml
 	class render_item_image : public render_item
 	{
 	protected:
+		size m_image_size;	// Image size the last layout was based on
+
 		int calc_max_height(int image_height, int containing_block_height);
 		int _render(int x, int y, const containing_block_context &containing_block_size, formatting_context* fmt_ctx, bool second_pass) override;
 
@@ -19,6 +21,8 @@ namespace litehtml
 		{
 			return std::make_shared<render_item_image>(src_el());
 		}
+
+		bool intrinsic_size_changed() override;
 	};
 }
 
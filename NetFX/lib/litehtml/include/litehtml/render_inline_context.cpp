@@ -2,6 +2,7 @@
 #include "render_inline_context.h"
 #include "document.h"
 #include "iterators.h"
+#include "render_text_run.h"
 
 int litehtml::render_item_inline_context::_render_content(int x, int y, bool second_pass, const containing_block_context &self_size, formatting_context* fmt_ctx)
 {
@@ -28,6 +29,32 @@ int litehtml::render_item_inline_context::_render_content(int x, int y, bool sec
 			switch (item_type)
 			{
 				case iterator_item_type_child:
+					if (el->src_el()->is_text_run())
+					{
+						// the pieces of a text run are placed one by one, with the same
+						// space collapsing as separate text elements
+						auto run = std::static_pointer_cast<render_item_text_run>(el);
+						run->reset_pieces();
+						for (size_t i = 0; i < run->pieces_count(); i++)
+						{
+							std::unique_ptr<line_box_item> piece(new lbi_text_piece(run, i));
+							if (skip_spaces)
+							{
+								if (piece->is_white_space())
+								{
+									if (was_space)
+									{
+										continue;
+									}
+									was_space = true;
+								} else
+								{
+									was_space = piece->is_break();
+								}
+							}
+							place_inline(std::move(piece), self_size, fmt_ctx);
+						}
+					} else
 					{
 						// skip spaces to make rendering a bit faster
 						if (skip_spaces)
@@ -69,6 +96,7 @@ int litehtml::render_item_inline_context::_render_content(int x, int y, bool sec
         });
 
     finish_last_box(true, self_size);
+    update_text_runs();
 
     if (!m_line_boxes.empty())
     {
@@ -199,9 +227,9 @@ int litehtml::render_item_inline_context::new_box(const std::unique_ptr<line_box
 
     if(el->get_el()->src_el()->is_inline() || el->get_el()->src_el()->is_block_formatting_context())
     {
-        if (el->get_el()->width() > line_ctx.right - line_ctx.left)
+        if (el->width() > line_ctx.right - line_ctx.left)
         {
-            line_ctx.top = fmt_ctx->find_next_line_top(line_ctx.top, el->get_el()->width(), self_size.render_width);
+            line_ctx.top = fmt_ctx->find_next_line_top(line_ctx.top, el->width(), self_size.render_width);
             line_ctx.left = 0;
             line_ctx.right = self_size.render_width;
             line_ctx.fix_top();
@@ -280,7 +308,7 @@ void litehtml::render_item_inline_context::place_inline(std::unique_ptr<line_box
 				item->get_el()->render(line_ctx.left, line_ctx.top, self_size.new_width(min_rendered_width), fmt_ctx);
 			}
 			item->set_rendered_min_width(min_rendered_width);
-		} else if(item->get_el()->src_el()->css().get_display() == display_inline_text)
+		} else if(item->get_el()->src_el()->css().get_display() == display_inline_text && !item->is_text_piece())
 		{
 			litehtml::size sz;
 			item->get_el()->src_el()->get_content_size(sz, line_ctx.right);
@@ -378,10 +406,28 @@ void litehtml::render_item_inline_context::apply_vertical_align()
             {
                 box->y_shift(add);
             }
+            update_text_runs();
         }
     }
 }
 
+void litehtml::render_item_inline_context::update_text_runs()
+{
+	// The pieces of one run are placed next to each other, so every run is visited once
+	render_item* last_run = nullptr;
+	for (const auto& box : m_line_boxes)
+	{
+		for (const auto& item : box->items())
+		{
+			if (item->is_text_piece() && item->get_el().get() != last_run)
+			{
+				last_run = item->get_el().get();
+				std::static_pointer_cast<render_item_text_run>(item->get_el())->update_bounds();
+			}
+		}
+	}
+}
+
 int litehtml::render_item_inline_context::get_first_baseline()
 {
 	int bl;
@@ -5,7 +5,17 @@
 
 litehtml::render_item::render_item(std::shared_ptr<element>  _src_el) :
         m_element(std::move(_src_el)),
-        m_skip(false)
+        m_skip(false),
+        m_laid_out(false),
+        m_needs_layout(false),
+        m_layout_width(0),
+        m_layout_second_pass(false),
+        m_layout_out_of_flow(false)
+{
+    update_box_model();
+}
+
+void litehtml::render_item::update_box_model()
 {
     document::ptr doc = src_el()->get_document();
     auto fnt_size = src_el()->css().get_font_size();
@@ -30,6 +40,19 @@ int litehtml::render_item::render(int x, int y, const containing_block_context&
 {
 	int ret;
 
+	if(can_reuse_layout(containing_block_size, fmt_ctx, second_pass))
+	{
+		m_pos = m_layout_pos;
+		m_pos.x += x;
+		m_pos.y += y;
+		m_margins = m_layout_margins;
+		return m_layout_width;
+	}
+
+	m_layout_cb = containing_block_size;
+	m_laid_out = true;
+	m_needs_layout = false;
+
 	calc_outlines(containing_block_size.width);
 
 	m_pos.clear();
@@ -54,9 +77,160 @@ int litehtml::render_item::render(int x, int y, const containing_block_context&
 		ret = _render(x, y, containing_block_size, fmt_ctx, second_pass);
 		fmt_ctx->pop_position(x + content_left, y + content_top);
 	}
+
+	m_layout_pos = m_pos;
+	m_layout_pos.x -= x;
+	m_layout_pos.y -= y;
+	m_layout_margins = m_margins;
+	m_layout_width = ret;
+	m_layout_second_pass = second_pass;
+	m_layout_out_of_flow = false;
+	for(const auto& child : m_children)
+	{
+		auto child_position = child->src_el()->css().get_position();
+		if(child_position == element_position_absolute || child_position == element_position_fixed || child->m_layout_out_of_flow)
+		{
+			m_layout_out_of_flow = true;
+			break;
+		}
+	}
 	return ret;
 }
 
+bool litehtml::render_item::can_reuse_layout(const containing_block_context& containing_block_size, formatting_context* fmt_ctx, bool second_pass) const
+{
+	if(!m_laid_out || m_needs_layout || second_pass != m_layout_second_pass || !(containing_block_size == m_layout_cb))
+	{
+		return false;
+	}
+
+	// Floats of the parent's formatting context shape lines inside any other box
+	if(fmt_ctx && !src_el()->is_block_formatting_context())
+	{
+		return false;
+	}
+
+	// Positioned boxes are placed by their containing block after the normal flow, so
+	// laying them out again from a cached position would lose their static position
+	auto el_position = src_el()->css().get_position();
+	return el_position != element_position_absolute && el_position != element_position_fixed && !m_layout_out_of_flow;
+}
+
+static bool has_positioned_descendants(const litehtml::render_item& ri)
+{
+	for(const auto& child : ri.children())
+	{
+		if(child->src_el()->css().get_position() != litehtml::element_position_static || has_positioned_descendants(*child))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void litehtml::render_item::set_needs_layout()
+{
+	// Boxes the last layout skipped keep their mark, so ancestors are marked regardless
+	for(auto ri = shared_from_this(); ri; ri = ri->parent())
+	{
+		ri->m_needs_layout = true;
+	}
+}
+
+void litehtml::render_item::invalidate_layout()
+{
+	std::vector<render_item*> stack;
+	for(const auto& child : m_children)
+	{
+		stack.push_back(child.get());
+	}
+	while(!stack.empty())
+	{
+		render_item* ri = stack.back();
+		stack.pop_back();
+		ri->m_needs_layout = true;
+		ri->update_box_model();
+		for(const auto& child : ri->m_children)
+		{
+			stack.push_back(child.get());
+		}
+	}
+	update_box_model();
+	set_needs_layout();
+}
+
+void litehtml::render_item::clear_needs_layout()
+{
+	if(!m_needs_layout)
+	{
+		return;
+	}
+	m_needs_layout = false;
+	for(const auto& child : m_children)
+	{
+		child->clear_needs_layout();
+	}
+}
+
+bool litehtml::render_item::is_layout_boundary() const
+{
+	if(!m_laid_out || is_root() || is_flex_item())
+	{
+		return false;
+	}
+
+	const auto& css = src_el()->css();
+	switch(css.get_display())
+	{
+	case display_block:
+	case display_inline_block:
+	case display_list_item:
+		break;
+	default:
+		// Table parts are sized by their table, inline boxes by their line
+		return false;
+	}
+
+	// Floats and relative shifts are placed by the parent's formatting context
+	if(css.get_position() != element_position_static || css.get_float() != float_none)
+	{
+		return false;
+	}
+
+	// Percentages may resolve against an auto height, which makes the box content sized
+	auto is_fixed = [](const css_length& len)
+		{
+			return !len.is_predefined() && len.units() != css_units_percentage;
+		};
+	if(!is_fixed(css.get_width()) || !is_fixed(css.get_height()))
+	{
+		return false;
+	}
+
+	// Floats inside do not leak out of a block formatting context
+	if(!src_el()->is_block_formatting_context())
+	{
+		return false;
+	}
+
+	// Positioned descendants are placed from outside of the subtree
+	return !has_positioned_descendants(*this);
+}
+
+void litehtml::render_item::relayout()
+{
+	// The parent may have moved the box or resolved auto margins after laying it out.
+	// Children are placed relative to it, so restoring the box is enough.
+	position old_pos = m_pos;
+	margins old_margins = m_margins;
+
+	render(old_pos.x - content_offset_left(), old_pos.y - content_offset_top(), m_layout_cb, nullptr);
+
+	m_pos.x = old_pos.x;
+	m_pos.y = old_pos.y;
+	m_margins = old_margins;
+}
+
 void litehtml::render_item::calc_outlines( int parent_width )
 {
     m_padding.left	= m_element->css().get_padding().left.calc_percent(parent_width);
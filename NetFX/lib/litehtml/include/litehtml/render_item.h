@@ -26,6 +26,21 @@ namespace litehtml
         position					                m_pos;
         bool                                        m_skip;
         std::vector<std::shared_ptr<render_item>>   m_positioned;
+        // Containing block of the last layout, so a layout boundary can be laid out again on its own
+        containing_block_context                    m_layout_cb;
+        bool                                        m_laid_out;
+        // Set on a box whose content changed size, and on all its ancestors
+        bool                                        m_needs_layout;
+        // Result of the last layout, relative to the position it was given, reused while
+        // the box is laid out again in the same containing block
+        position                                    m_layout_pos;
+        margins                                     m_layout_margins;
+        int                                         m_layout_width;
+        bool                                        m_layout_second_pass;
+        // Whether absolutely or fixed positioned boxes were laid out inside
+        bool                                        m_layout_out_of_flow;
+
+		bool can_reuse_layout(const containing_block_context& containing_block_size, formatting_context* fmt_ctx, bool second_pass) const;
 
 		containing_block_context calculate_containing_block_context(const containing_block_context& cb_context);
 		void calc_cb_length(const css_length& len, int percent_base, containing_block_context::typed_int& out_value) const;
@@ -44,6 +59,11 @@ namespace litehtml
             return m_children;
         }
 
+        const std::list<std::shared_ptr<render_item>>& children() const
+        {
+            return m_children;
+        }
+
         position& pos()
         {
             return m_pos;
@@ -331,6 +351,35 @@ namespace litehtml
 		}
 
 		int render(int x, int y, const containing_block_context& containing_block_size, formatting_context* fmt_ctx, bool second_pass = false);
+
+		bool needs_layout() const
+		{
+			return m_needs_layout;
+		}
+		void set_needs_layout();
+		void clear_needs_layout();
+		/**
+		 * Marks the whole subtree for layout, after its styles changed.
+		 * Margins, paddings and borders are resolved again from the new styles.
+		 */
+		void invalidate_layout();
+		/**
+		 * Resolves margins, paddings and borders from the computed styles.
+		 */
+		void update_box_model();
+		/**
+		 * Whether neither the size nor the position of this box depends on its content,
+		 * so laying it out again cannot move anything outside of it.
+		 */
+		bool is_layout_boundary() const;
+		/**
+		 * Lays out the subtree again in the containing block of the last layout, keeping the box in place.
+		 */
+		void relayout();
+		/**
+		 * Whether the container now reports a different intrinsic size than the one the last layout used.
+		 */
+		virtual bool intrinsic_size_changed() { return false; }
         void apply_relative_shift(const containing_block_context &containing_block_size);
         void calc_outlines( int parent_width );
         int calc_auto_margins(int parent_width);	// returns left margin
@@ -0,0 +1,70 @@
+#ifndef LITEHTML_RENDER_TEXT_RUN_H
+#define LITEHTML_RENDER_TEXT_RUN_H
+
+#include "render_inline.h"
+#include "el_text_run.h"
+
+namespace litehtml
+{
+	/**
+	 * Render item of an el_text_run. Keeps the position of every piece placed by
+	 * the line layout; pos() is the bounding box of the placed pieces.
+	 */
+	class render_item_text_run : public render_item_inline
+	{
+	protected:
+		std::vector<position>	m_pieces_pos;
+		std::vector<bool>		m_pieces_skip;
+
+	public:
+		explicit render_item_text_run(std::shared_ptr<element>  _src_el) : render_item_inline(std::move(_src_el))
+		{
+			size_t count = std::static_pointer_cast<el_text_run>(src_el())->pieces_count();
+			m_pieces_pos.resize(count);
+			m_pieces_skip.assign(count, true);
+		}
+
+		size_t		pieces_count() const			{ return m_pieces_pos.size(); }
+		position&	piece_pos(size_t idx)			{ return m_pieces_pos[idx]; }
+		bool		piece_skip(size_t idx) const	{ return m_pieces_skip[idx]; }
+		void		piece_skip(size_t idx, bool val)	{ m_pieces_skip[idx] = val; }
+
+		// Pieces not placed again by the next layout pass stay hidden
+		void reset_pieces()
+		{
+			m_pieces_skip.assign(m_pieces_skip.size(), true);
+		}
+
+		void update_bounds()
+		{
+			bool first = true;
+			m_pos = position();
+			for(size_t i = 0; i < m_pieces_pos.size(); i++)
+			{
+				if(m_pieces_skip[i]) continue;
+
+				const position& pp = m_pieces_pos[i];
+				if(first)
+				{
+					m_pos = pp;
+					first = false;
+				} else
+				{
+					int right	= std::max(m_pos.right(), pp.right());
+					int bottom	= std::max(m_pos.bottom(), pp.bottom());
+					m_pos.x		= std::min(m_pos.x, pp.x);
+					m_pos.y		= std::min(m_pos.y, pp.y);
+					m_pos.width		= right - m_pos.x;
+					m_pos.height	= bottom - m_pos.y;
+				}
+			}
+		}
+
+		std::shared_ptr<render_item> clone() override
+		{
+			return std::make_shared<render_item_text_run>(src_el());
+		}
+	};
+}
+
+#endif //LITEHTML_RENDER_TEXT_RUN_H
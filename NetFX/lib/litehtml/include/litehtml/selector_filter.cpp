@@ -0,0 +1,92 @@
+#include "html.h"
+#include "selector_filter.h"
+#include "css_selector.h"
+#include "element.h"
+
+unsigned litehtml::selector_filter::key_hash(key_type type, string_id key)
+{
+	// Fibonacci hashing; the filter takes its two indexes from the upper bits
+	unsigned hash = (((unsigned) key << 2) | (unsigned) type) * 0x9E3779B1u;
+	return hash ? hash : 1;
+}
+
+void litehtml::selector_filter::add(unsigned hash)
+{
+	unsigned char& first	= m_counters[hash >> (32 - hash_bits)];
+	unsigned char& second	= m_counters[(hash >> 8) & hash_mask];
+	if(first != 0xFF) first++;
+	if(second != 0xFF) second++;
+}
+
+void litehtml::selector_filter::remove(unsigned hash)
+{
+	unsigned char& first	= m_counters[hash >> (32 - hash_bits)];
+	unsigned char& second	= m_counters[(hash >> 8) & hash_mask];
+	if(first != 0xFF) first--;
+	if(second != 0xFF) second--;
+}
+
+bool litehtml::selector_filter::contains(unsigned hash) const
+{
+	return m_counters[hash >> (32 - hash_bits)] && m_counters[(hash >> 8) & hash_mask];
+}
+
+void litehtml::selector_filter::push(string_id tag, string_id id, const std::vector<string_id>& classes)
+{
+	add(key_hash(key_tag, tag));
+	if(id != empty_id)
+	{
+		add(key_hash(key_id, id));
+	}
+	for(auto cls : classes)
+	{
+		add(key_hash(key_class, cls));
+	}
+}
+
+void litehtml::selector_filter::pop(string_id tag, string_id id, const std::vector<string_id>& classes)
+{
+	remove(key_hash(key_tag, tag));
+	if(id != empty_id)
+	{
+		remove(key_hash(key_id, id));
+	}
+	for(auto cls : classes)
+	{
+		remove(key_hash(key_class, cls));
+	}
+}
+
+void litehtml::selector_filter::push_ancestors(const std::shared_ptr<element>& el)
+{
+	for(auto ancestor = el; ancestor; ancestor = ancestor->parent())
+	{
+		// Same normalization as html_tag::set_attr applies to m_classes
+		std::vector<string_id> classes;
+		const char* class_attr = ancestor->get_attr("class");
+		if(class_attr)
+		{
+			string val = class_attr;
+			lcase(val);
+			string_vector tokens;
+			split_string(val, tokens, " ");
+			for(const auto& token : tokens)
+			{
+				classes.push_back(_id(token));
+			}
+		}
+		push(ancestor->tag(), ancestor->id(), classes);
+	}
+}
+
+bool litehtml::selector_filter::may_match(const css_selector& selector) const
+{
+	for(int i = 0; i < max_selector_hashes && selector.m_ancestor_hashes[i]; i++)
+	{
+		if(!contains(selector.m_ancestor_hashes[i]))
+		{
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,53 @@
+#ifndef LH_SELECTOR_FILTER_H
+#define LH_SELECTOR_FILTER_H
+
+#include "string_id.h"
+#include <memory>
+#include <vector>
+
+namespace litehtml
+{
+	class element;
+	class css_selector;
+
+	// Counting Bloom filter of the tags, ids and classes of the ancestors of
+	// the element being styled. Selectors whose ancestor compounds need a key
+	// that is not in the filter cannot match, so the parent chain is never walked
+	// for them. False positives only cost the usual match.
+	class selector_filter
+	{
+	public:
+		static const int max_selector_hashes = 4;
+
+	private:
+		static const int	hash_bits	= 12;
+		static const int	hash_mask	= (1 << hash_bits) - 1;
+
+		// Counters stick once they saturate, which only makes the filter less selective
+		unsigned char		m_counters[1 << hash_bits] = {};
+
+		void add(unsigned hash);
+		void remove(unsigned hash);
+		bool contains(unsigned hash) const;
+
+	public:
+		enum key_type
+		{
+			key_tag,
+			key_id,
+			key_class,
+		};
+
+		static unsigned key_hash(key_type type, string_id key);
+
+		void push(string_id tag, string_id id, const std::vector<string_id>& classes);
+		void pop(string_id tag, string_id id, const std::vector<string_id>& classes);
+
+		// Seeds the filter with el and everything above it, for styling starting below the root
+		void push_ancestors(const std::shared_ptr<element>& el);
+
+		bool may_match(const css_selector& selector) const;
+	};
+}
+
+#endif  // LH_SELECTOR_FILTER_H
@@ -122,6 +122,9 @@ bool litehtml::css::parse_selectors( const string& txt, const style::ptr& styles
 		if(new_selector->parse(token))
 		{
 			new_selector->calc_specificity();
+			new_selector->calc_ancestor_hashes();
+			new_selector->calc_position_sensitivity();
+			new_selector->calc_state_sensitivity();
 			add_selector(new_selector);
 			added_something = true;
 		}
@@ -130,6 +133,56 @@ bool litehtml::css::parse_selectors( const string& txt, const style::ptr& styles
 	return added_something;
 }
 
+litehtml::css::const_ptr litehtml::css::create_shared(const char* str, document_container* container, const char* baseurl)
+{
+	// The parser only needs a document for the container; nothing refers back to it
+	auto doc = std::make_shared<document>(container);
+	auto sheet = std::make_shared<css>();
+	if(str && *str)
+	{
+		sheet->parse_stylesheet(str, baseurl, doc, nullptr);
+	}
+	sheet->sort_selectors();
+	return sheet;
+}
+
+litehtml::css::const_ptr litehtml::css::with_own_media(const const_ptr& sheet)
+{
+	if(!sheet || !sheet->m_has_media)
+	{
+		return sheet;
+	}
+
+	// Positions do not change, so the copied index stays valid
+	auto copy = std::make_shared<css>(*sheet);
+	std::map<media_query_list*, media_query_list::ptr> lists;
+	for(auto& sel : copy->m_selectors)
+	{
+		if(!sel->m_media_query) continue;
+
+		media_query_list::ptr& list = lists[sel->m_media_query.get()];
+		if(!list)
+		{
+			list = std::make_shared<media_query_list>(*sel->m_media_query);
+		}
+
+		// The copy constructor leaves the style behind
+		auto own = std::make_shared<css_selector>(*sel);
+		own->m_style = sel->m_style;
+		own->m_media_query = list;
+		sel = own;
+	}
+	return copy;
+}
+
+void litehtml::css::add_media_to_doc(document* doc) const
+{
+	for(const auto& sel : m_selectors)
+	{
+		sel->add_media_to_doc(doc);
+	}
+}
+
 void litehtml::css::sort_selectors()
 {
 	std::sort(m_selectors.begin(), m_selectors.end(),
@@ -138,6 +191,97 @@ void litehtml::css::sort_selectors()
 			 return (*v1) < (*v2);
 		 }
 	);
+	build_index();
+}
+
+void litehtml::css::clear_index()
+{
+	m_by_id.clear();
+	m_by_class.clear();
+	m_by_tag.clear();
+	m_universal.clear();
+	m_indexed = false;
+}
+
+void litehtml::css::build_index()
+{
+	clear_index();
+
+	for(int i = 0; i < (int) m_selectors.size(); i++)
+	{
+		const css_element_selector& right = m_selectors[i]->m_right;
+
+		// An id is the rarest key, so it wins over classes and the tag
+		const css_attribute_selector* cls = nullptr;
+		const css_attribute_selector* id = nullptr;
+		for(const auto& attr : right.m_attrs)
+		{
+			if(attr.type == select_id && !id)
+			{
+				id = &attr;
+			} else if(attr.type == select_class && !cls)
+			{
+				cls = &attr;
+			}
+		}
+
+		if(id)
+		{
+			m_by_id[id->name].push_back(i);
+		} else if(cls)
+		{
+			m_by_class[cls->name].push_back(i);
+		} else if(right.m_tag != star_id)
+		{
+			m_by_tag[right.m_tag].push_back(i);
+		} else
+		{
+			m_universal.push_back(i);
+		}
+	}
+	m_indexed = true;
+}
+
+void litehtml::css::get_candidates(string_id tag, string_id id, const std::vector<string_id>& classes, std::vector<int>& candidates) const
+{
+	candidates.clear();
+
+	// Buckets are sorted already, so merging them keeps the list in order
+	auto add_bucket = [&candidates](const std::vector<int>& bucket)
+		{
+			if(bucket.empty())
+			{
+				return;
+			}
+			size_t middle = candidates.size();
+			candidates.insert(candidates.end(), bucket.begin(), bucket.end());
+			if(middle && candidates[middle - 1] > bucket.front())
+			{
+				std::inplace_merge(candidates.begin(), candidates.begin() + middle, candidates.end());
+			}
+		};
+	auto add_key = [&add_bucket](const selector_buckets& buckets, string_id key)
+		{
+			auto it = buckets.find(key);
+			if(it != buckets.end())
+			{
+				add_bucket(it->second);
+			}
+		};
+
+	if(id != empty_id)
+	{
+		add_key(m_by_id, id);
+	}
+	for(auto cls : classes)
+	{
+		add_key(m_by_class, cls);
+	}
+	add_key(m_by_tag, tag);
+	add_bucket(m_universal);
+
+	// Every selector sits in a single bucket, so only repeated classes give duplicates
+	candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
 }
 
 void litehtml::css::parse_atrule(const string& text, const char* baseurl, const std::shared_ptr<document>& doc, const media_query_list::ptr& media)
@@ -10,7 +10,23 @@ namespace litehtml
 
 	class css
 	{
+	public:
+		typedef std::shared_ptr<const css>	const_ptr;
+
+	private:
+		typedef std::unordered_map<string_id, std::vector<int>> selector_buckets;
+
 		css_selector::vector	m_selectors;
+
+		// Positions in m_selectors keyed by the rightmost compound's id, first
+		// class or tag, in that order of preference; selectors with none of
+		// those go to m_universal. Built by sort_selectors().
+		selector_buckets		m_by_id;
+		selector_buckets		m_by_class;
+		selector_buckets		m_by_tag;
+		std::vector<int>		m_universal;
+		bool					m_indexed = false;
+		bool					m_has_media = false;
 	public:
 		css() = default;
 		~css() = default;
@@ -23,16 +39,38 @@ namespace litehtml
 		void clear()
 		{
 			m_selectors.clear();
+			m_has_media = false;
+			clear_index();
+		}
+
+		bool is_indexed() const
+		{
+			return m_indexed;
 		}
 
 		void	parse_stylesheet(const char* str, const char* baseurl, const std::shared_ptr<document>& doc, const media_query_list::ptr& media);
 		void	sort_selectors();
 		static void	parse_css_url(const string& str, string& url);
 
+		// Parsed and sorted once, then only read, so any number of documents can
+		// apply it; documents take it through with_own_media()
+		static const_ptr	create_shared(const char* str, document_container* container, const char* baseurl = nullptr);
+		// Media lists carry the result of their last evaluation, so a sheet with
+		// media queries is copied with fresh lists for each document. Sheets
+		// without any are returned as they are.
+		static const_ptr	with_own_media(const const_ptr& sheet);
+		void	add_media_to_doc(document* doc) const;
+
+		// Positions of the selectors whose rightmost compound can match an element
+		// with this tag, id and classes, ascending (i.e. in specificity order)
+		void	get_candidates(string_id tag, string_id id, const std::vector<string_id>& classes, std::vector<int>& candidates) const;
+
 	private:
 		void	parse_atrule(const string& text, const char* baseurl, const std::shared_ptr<document>& doc, const media_query_list::ptr& media);
 		void	add_selector(const css_selector::ptr& selector);
 		bool	parse_selectors(const string& txt, const style::ptr& styles, const media_query_list::ptr& media);
+		void	build_index();
+		void	clear_index();
 
 	};
 
@@ -40,6 +78,11 @@ namespace litehtml
 	{
 		selector->m_order = (int) m_selectors.size();
 		m_selectors.push_back(selector);
+		if(selector->m_media_query)
+		{
+			m_has_media = true;
+		}
+		clear_index();
 	}
 
 }
@@ -4,6 +4,7 @@
 #include <cstdlib>
 #include <memory>
 #include <map>
+#include <unordered_map>
 #include <vector>
 #include <list>
 
@@ -174,7 +175,8 @@ namespace litehtml
 		font_metrics	metrics;
 	};
 
-	typedef std::map<string, font_item> fonts_map;
+	// keyed by document::font_key()
+	typedef std::unordered_map<uint64_t, font_item> fonts_map;
 
 	enum draw_flag
 	{
@@ -231,6 +233,11 @@ namespace litehtml
 				type = v.type;
 				return *this;
 			}
+
+			bool operator==(const typed_int& v) const
+			{
+				return value == v.value && type == v.type;
+			}
 		};
 
 		typed_int width;						// width of the containing block
@@ -275,6 +282,14 @@ namespace litehtml
 			ret.size_mode = _size_mode;
 			return ret;
 		}
+
+		bool operator==(const containing_block_context& v) const
+		{
+			return width == v.width && render_width == v.render_width &&
+				min_width == v.min_width && max_width == v.max_width &&
+				height == v.height && min_height == v.min_height && max_height == v.max_height &&
+				context_idx == v.context_idx && size_mode == v.size_mode;
+		}
 	};
 
 #define  style_display_strings		"none;block;inline;inline-block;inline-table;list-item;table;table-caption;table-cell;table-column;table-column-group;table-footer-group;table-header-group;table-row;table-row-group;inline-text;flex;inline-flex"
@@ -1,6 +1,18 @@
 #include "html.h"
 #include "utf8_strings.h"
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define LH_SCAN_BLOCK 32
+#elif defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define LH_SCAN_BLOCK 16
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 
 litehtml::utf8_to_wchar::utf8_to_wchar(const char* val)
 {
@@ -97,3 +109,169 @@ litehtml::wchar_to_utf8::wchar_to_utf8(const std::wstring& val)
 		}
 	}
 }
+
+// Length of the well-formed UTF-8 sequence at s (Unicode table 3-7), 0 if there is none
+static size_t utf8_sequence_length(const unsigned char* s, size_t avail)
+{
+	unsigned char lo = 0x80;
+	unsigned char hi = 0xBF;
+	size_t len;
+
+	if (s[0] < 0x80)
+	{
+		return 1;
+	} else if (s[0] >= 0xC2 && s[0] <= 0xDF)
+	{
+		len = 2;
+	} else if (s[0] >= 0xE0 && s[0] <= 0xEF)
+	{
+		len = 3;
+		if (s[0] == 0xE0) lo = 0xA0;		// overlong
+		else if (s[0] == 0xED) hi = 0x9F;	// surrogates
+	} else if (s[0] >= 0xF0 && s[0] <= 0xF4)
+	{
+		len = 4;
+		if (s[0] == 0xF0) lo = 0x90;		// overlong
+		else if (s[0] == 0xF4) hi = 0x8F;	// above U+10FFFF
+	} else
+	{
+		return 0;
+	}
+
+	if (avail < len || s[1] < lo || s[1] > hi) return 0;
+	for (size_t i = 2; i < len; i++)
+	{
+		if ((s[i] & 0xC0) != 0x80) return 0;
+	}
+	return len;
+}
+
+static inline bool is_scan_space(unsigned char c)
+{
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f';
+}
+
+#ifdef LH_SCAN_BLOCK
+static inline unsigned lowest_bit(uint32_t mask)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return (unsigned) index;
+#else
+	return (unsigned) __builtin_ctz(mask);
+#endif
+}
+
+// Bit i of spaces/non_ascii is set if byte i of the block is white space/not ASCII
+static inline void classify_block(const char* p, uint32_t& spaces, uint32_t& non_ascii)
+{
+#if LH_SCAN_BLOCK == 32
+	__m256i v = _mm256_loadu_si256((const __m256i*) p);
+	__m256i ws = _mm256_or_si256(
+		_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))),
+		_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')),
+			_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\f')))));
+	spaces		= (uint32_t) _mm256_movemask_epi8(ws);
+	non_ascii	= (uint32_t) _mm256_movemask_epi8(v);
+#else
+	__m128i v = _mm_loadu_si128((const __m128i*) p);
+	__m128i ws = _mm_or_si128(
+		_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+		_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')),
+			_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\r')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\f')))));
+	spaces		= (uint32_t) _mm_movemask_epi8(ws);
+	non_ascii	= (uint32_t) _mm_movemask_epi8(v);
+#endif
+}
+#endif
+
+bool litehtml::scan_utf8_text(const char* text, size_t length, std::vector<text_piece>& pieces)
+{
+	const unsigned char* s = (const unsigned char*) text;
+	bool valid = true;
+	size_t word_start = 0;
+	size_t i = 0;
+
+	auto add_piece = [&](size_t pos, size_t len, text_piece_class cls)
+	{
+		if (pos > word_start)
+		{
+			pieces.push_back({ (uint32_t) word_start, (uint32_t) (pos - word_start), text_piece_word });
+		}
+		pieces.push_back({ (uint32_t) pos, (uint32_t) len, cls });
+		word_start = pos + len;
+	};
+
+#ifdef LH_SCAN_BLOCK
+	// Bytes before scalar_end belong to a block that had non-ASCII bytes; they are
+	// finished one by one instead of classifying an overlapping block again
+	size_t scalar_end = 0;
+#endif
+
+	while (i < length)
+	{
+#ifdef LH_SCAN_BLOCK
+		if (i >= scalar_end && i + LH_SCAN_BLOCK <= length)
+		{
+			uint32_t spaces, non_ascii;
+			classify_block(text + i, spaces, non_ascii);
+
+			// The masks are final only up to the first non-ASCII byte
+			if (non_ascii)
+			{
+				spaces &= (non_ascii & (0u - non_ascii)) - 1;
+			}
+			while (spaces)
+			{
+				add_piece(i + lowest_bit(spaces), 1, text_piece_space);
+				spaces &= spaces - 1;
+			}
+
+			if (!non_ascii)
+			{
+				i += LH_SCAN_BLOCK;
+				continue;
+			}
+			scalar_end = i + LH_SCAN_BLOCK;
+			i += lowest_bit(non_ascii);
+		}
+#endif
+
+		if (s[i] < 0x80)
+		{
+			if (is_scan_space(s[i]))
+			{
+				add_piece(i, 1, text_piece_space);
+			}
+			i++;
+			continue;
+		}
+
+		size_t len = utf8_sequence_length(s + i, length - i);
+		if (!len)
+		{
+			valid = false;
+			add_piece(i, 1, text_piece_invalid);
+			i++;
+			continue;
+		}
+
+		// CJK ideographs U+4E00..U+9FCC break like words of their own
+		if (len == 3)
+		{
+			ucode_t code = ((s[i] & 0x0F) << 12) | ((s[i + 1] & 0x3F) << 6) | (s[i + 2] & 0x3F);
+			if (code >= 0x4E00 && code <= 0x9FCC)
+			{
+				add_piece(i, 3, text_piece_ideograph);
+			}
+		}
+		i += len;
+	}
+
+	if (length > word_start)
+	{
+		pieces.push_back({ (uint32_t) word_start, (uint32_t) (length - word_start), text_piece_word });
+	}
+	return valid;
+}
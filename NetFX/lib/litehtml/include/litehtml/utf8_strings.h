@@ -45,6 +45,29 @@ namespace litehtml
 		}
 	};
 
+	enum text_piece_class
+	{
+		text_piece_word,		// part of a word, may be continued by the next piece
+		text_piece_space,		// one white space character
+		text_piece_ideograph,	// one CJK ideograph, breaks like a word of its own
+		text_piece_invalid,		// one byte that does not start a valid UTF-8 sequence
+	};
+
+	struct text_piece
+	{
+		uint32_t			offset;
+		uint32_t			length;
+		text_piece_class	cls;
+	};
+
+	/**
+	 * Splits UTF-8 text at the same places as document_container::split_text, without
+	 * transcoding: pieces are byte ranges of the original buffer. Runs of ASCII are
+	 * classified 16 (SSE2) or 32 (AVX2) bytes at a time; multi-byte sequences are
+	 * validated on the way. Returns false if any invalid byte was found.
+	 */
+	bool scan_utf8_text(const char* text, size_t length, std::vector<text_piece>& pieces);
+
 #define litehtml_from_wchar(str)	litehtml::wchar_to_utf8(str)
 #define litehtml_to_wchar(str)		litehtml::utf8_to_wchar(str)
 }
@@ -3,6 +3,8 @@
 #include <iostream>
 #include <chrono>
 #include <thread>
+#include <climits>
+#include <algorithm>
 #include "../bytesize.h"
 
 NFX_Browser::NFX_Browser(SDL_Window* window) : window(window)
@@ -13,13 +15,33 @@ NFX_Browser::NFX_Browser(SDL_Window* window) : window(window)
         exit(-1);
     }
 
+    this->connection_pool = new NFX_ConnectionPool();
+    this->http_cache = new NFX_HttpCache("cache", HTTP_CACHE_BUDGET);
+    this->fetch_scheduler = new NFX_FetchScheduler(this->connection_pool, this->http_cache);
+    this->resource_cache = new NFX_ResourceCache(RESOURCE_ENCODED_BUDGET, RESOURCE_TEXTURE_BUDGET);
+
     this->container = new NFX_Container(this->renderer);
     this->container->set_browser(this);
+    this->container->set_fetch_scheduler(this->fetch_scheduler);
+    this->container->set_resource_cache(this->resource_cache);
+
+    this->master_css = litehtml::css::create_shared(litehtml::master_css, this->container);
+    this->default_css = litehtml::css::create_shared(get_default_css().c_str(), this->container);
+
+    this->wake_event = SDL_RegisterEvents(1);
 }
 
 NFX_Browser::~NFX_Browser()
 {
+    // Workers call back into the container, so stop them first
+    delete this->fetch_scheduler;
     delete this->container;
+    delete this->resource_cache;
+    delete this->http_cache;
+    delete this->connection_pool;
+    if (this->page_texture) {
+        SDL_DestroyTexture(this->page_texture);
+    }
     SDL_DestroyRenderer(this->renderer);
 }
 
@@ -87,190 +109,334 @@ void NFX_Browser::load(NFX_Url& url)
 {
     std::cout << "Loading URL: " << url.to_str() << std::endl;
 
-    this->base_url = url.to_str();
+    // Subresources of the previous page are no longer wanted
+    this->fetch_scheduler->cancel_all();
 
-    try {
-        httplib::Result res;
+    NFX_FetchScheduler::Stats stats = this->fetch_scheduler->get_stats();
+    std::cout << "Fetch stats: " << stats.completed << " completed, " << stats.cancelled << " cancelled, "
+        << "peak queue " << stats.peak_queue_depth << ", avg wait " << stats.average_wait_ms() << " ms, "
+        << "max wait " << stats.max_wait_ms << " ms" << std::endl;
 
-        // Set user agent to avoid blocking
-        httplib::Headers headers = {
-            {"User-Agent", "NetFX Browser/1.0"},
-            {"Accept", "text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8"},
-            {"Accept-Language", "en-US,en;q=0.5"},
-            {"Accept-Encoding", "identity"},  // Don't accept compressed content for simplicity
-            {"Connection", "close"}  // Don't keep connection alive
-        };
+    NFX_HttpCache::Stats cache_stats = this->http_cache->get_stats();
+    std::cout << "HTTP cache: " << cache_stats.hits << " hits, " << cache_stats.revalidated << " revalidated, "
+        << cache_stats.misses << " misses, " << cache_stats.bytes / KiB << " KiB stored" << std::endl;
 
-        std::cout << "Connecting to " << url.hostname << ":" << url.port << std::endl;
+    NFX_ResourceCache::Stats resource_stats = this->resource_cache->get_stats();
+    std::cout << "Resource cache: " << resource_stats.hits << " hits, " << resource_stats.misses << " misses, "
+        << resource_stats.encoded_bytes / KiB << " KiB encoded, " << resource_stats.texture_bytes / KiB << " KiB textures, "
+        << resource_stats.evicted_textures << " textures evicted" << std::endl;
 
-        // Handle HTTPS and HTTP separately
-        if (url.is_https()) {
-            httplib::SSLClient ssl_cli(url.hostname, url.port);
+    NFX_TextMeasurer::Stats text_stats = this->container->get_text_stats();
+    std::cout << "Text measurement: " << text_stats.table_hits << " table hits, " << text_stats.lru_hits << " cached, "
+        << text_stats.misses << " measured (" << text_stats.measure_ms << " ms), " << text_stats.mismatches << " table mismatches, "
+        << "~" << text_stats.saved_ms() << " ms saved" << std::endl;
 
-            // Configure SSL client
-            ssl_cli.enable_server_certificate_verification(false);
-            ssl_cli.set_ca_cert_path("");
+    NFX_TextCache::Stats run_stats = this->container->get_text_cache_stats();
+    std::cout << "Text run cache: " << run_stats.hits << " hits, " << run_stats.misses << " misses, "
+        << run_stats.entries << " runs, " << run_stats.bytes / KiB << " KiB, " << run_stats.evicted << " evicted" << std::endl;
 
-            // Set timeouts
-            ssl_cli.set_connection_timeout(10, 0);  // 10 seconds
-            ssl_cli.set_read_timeout(15, 0);        // 15 seconds
-            ssl_cli.set_write_timeout(10, 0);       // 10 seconds
-            ssl_cli.set_follow_location(true);
+    // Documents of older navigations that finish late are thrown away
+    uint64_t navigation = ++this->navigation_id;
+    this->container->clear_imported_css();
 
-            res = ssl_cli.Get(url.path, headers);
+    {
+        // A partial document of an abandoned navigation must not be swapped in anymore
+        std::lock_guard<std::mutex> lock(this->pending_mutex);
+        this->pending_document = nullptr;
+    }
+
+    // The abandoned navigation no longer needs its resources, the shown page still does
+    if (this->loading_navigation != this->displayed_navigation) {
+        this->resource_cache->release_page(this->loading_navigation);
+        this->container->release_page(this->loading_navigation);
+    }
+    this->loading_navigation = navigation;
+    this->resource_cache->retain_page(navigation);
+
+    // Get window size for rendering, the worker must not touch the window
+    int window_width = 800;
+    int window_height = 600;
+    SDL_GetWindowSize(this->window, &window_width, &window_height);
+
+    NFX_FetchRequest request(url);
+    request.priority = NFX_FETCH_DOCUMENT;
+    request.follow_location = true;
+
+    // Set user agent to avoid blocking
+    request.headers = {
+        {"User-Agent", "NetFX Browser/1.0"},
+        {"Accept", "text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8"},
+        {"Accept-Language", "en-US,en;q=0.5"}
+    };
+
+    std::cout << "Connecting to " << url.hostname << ":" << url.port << std::endl;
+
+    // Fetch, parse and layout run on a scheduler worker while the current
+    // document keeps painting; render() swaps the result in when it is ready
+    std::string page_url = url.to_str();
+    auto stream = std::make_shared<StreamingPage>();
+
+    // Subresources are requested as soon as their tags stream past, so their
+    // fetches overlap with the rest of the download and the parse
+    NFX_Container* container = this->container;
+    StreamingPage* page = stream.get();
+    stream->scanner = std::make_unique<NFX_PreloadScanner>([container, page, page_url](const NFX_PreloadResource& resource) {
+        if (resource.type == NFX_PreloadResource::STYLESHEET) {
+            container->preload_css(resource.url, page_url);
         }
         else {
-            httplib::Client http_cli(url.hostname, url.port);
-
-            // Set timeouts
-            http_cli.set_connection_timeout(10, 0);  // 10 seconds
-            http_cli.set_read_timeout(15, 0);        // 15 seconds
-            http_cli.set_write_timeout(10, 0);       // 10 seconds
-            http_cli.set_follow_location(true);
+            NFX_FetchPriority priority = page->images_seen++ < PRELOAD_VISIBLE_IMAGES
+                ? NFX_FETCH_VISIBLE_IMAGE
+                : NFX_FETCH_OFFSCREEN_IMAGE;
+            container->preload_image(resource.url, page_url, priority);
+        }
+    });
+
+    request.on_response = [stream](const httplib::Response& res) {
+        stream->status = res.status;
+        return true;
+    };
+
+    // Publish partial documents while the body streams in. Each partial
+    // parse waits until the received size has doubled, so the total parse
+    // work stays within a small multiple of one full parse.
+    request.on_data = [this, stream, page_url, navigation, window_width](const char* data, size_t length) {
+        if (stream->status != 200) return true;
+        if (navigation != this->navigation_id) return false;
+
+        // Preloads and the parse below belong to this navigation's page
+        this->container->set_page(navigation);
+
+        stream->html.append(data, length);
+        stream->scanner->feed(data, length);
+        if (stream->html.size() < stream->next_partial_size) return true;
+
+        stream->next_partial_size = stream->html.size() * 2;
+
+        // Cut after the last complete tag so gumbo does not see half an element
+        size_t cut = stream->html.rfind('>');
+        if (cut == std::string::npos) return true;
+
+        // Parsed in place, the prefix is not copied out of the growing buffer
+        auto doc = this->create_document(stream->html.data(), cut + 1, page_url, window_width, true);
+        if (doc) {
+            std::cout << "Partial document published at " << cut + 1 << " bytes" << std::endl;
+            this->publish_document(std::move(doc), page_url, navigation);
+        }
+        return true;
+    };
 
-            res = http_cli.Get(url.path, headers);
+    request.on_complete = [this, url, page_url, stream, navigation, window_width](httplib::Result& res) {
+        if (res && res->status == 200) {
+            res->body = std::move(stream->html);
         }
 
-        if (res) {
-            std::cout << "HTTP Status: " << res->status << std::endl;
+        std::string html = this->get_response_html(res, url);
+        if (navigation != this->navigation_id) return;
 
-            if (res->status == 200) {
-                this->current_html = res->body;
-                std::cout << "Downloaded " << this->current_html.length() << " bytes" << std::endl;
+        this->container->set_page(navigation);
 
-                // Limit HTML size to prevent memory issues
-                const size_t MAX_HTML_SIZE = 8 * MiB;
-                if (this->current_html.length() > MAX_HTML_SIZE) {
-                    std::cout << "HTML too large, truncating..." << std::endl;
-                    this->current_html = this->current_html.substr(0, MAX_HTML_SIZE);
-                }
+        auto doc = this->create_document(html.data(), html.size(), page_url, window_width);
+        if (doc) {
+            std::cout << "LiteHTML document loaded and rendered successfully!" << std::endl;
+            this->publish_document(std::move(doc), page_url, navigation);
+        }
+    };
 
-                // Create litehtml document with default CSS
-                std::string css = get_default_css();
+    this->fetch_scheduler->submit(std::move(request));
+}
 
-                this->container->set_base_url(this->base_url.c_str());
+std::string NFX_Browser::get_response_html(httplib::Result& res, const NFX_Url& url)
+{
+    if (res) {
+        std::cout << "HTTP Status: " << res->status << std::endl;
 
-                try {
-                    this->document = litehtml::document::createFromString(
-                        this->current_html.c_str(),
-                        this->container,
-                        litehtml::master_css,
-                        css.c_str()
-                    );
+        if (res->status == 200) {
+            std::cout << "Downloaded " << res->body.length() << " bytes" << std::endl;
+            return std::move(res->body);
+        }
+        else if (res->status >= 300 && res->status < 400) {
+            std::cout << "Redirect status: " << res->status << std::endl;
+            // httplib should handle redirects automatically, but if we get here it means redirect failed
+            return "<html><body><h1>Redirect Error</h1><p>Too many redirects or redirect failed</p></body></html>";
+        }
+        else {
+            std::cout << "HTTP Error: " << res->status << std::endl;
+            return "<html><body><h1>HTTP Error " + std::to_string(res->status) + "</h1><p>Failed to load page</p></body></html>";
+        }
+    }
 
-                    if (this->document) {
-                        // Get window size for rendering
-                        int window_width = 800;
-                        int window_height = 600;
-                        SDL_GetWindowSize(this->window, &window_width, &window_height);
+    auto err = res.error();
+    std::cout << "Connection error: " << httplib::to_string(err) << std::endl;
+
+    std::string error_msg;
+    switch (err) {
+    case httplib::Error::Connection:
+        error_msg = "Connection failed - check if the server is reachable";
+        break;
+    case httplib::Error::BindIPAddress:
+        error_msg = "Failed to bind IP address";
+        break;
+    case httplib::Error::Read:
+        error_msg = "Read timeout or connection lost";
+        break;
+    case httplib::Error::Write:
+        error_msg = "Write timeout or connection lost";
+        break;
+    case httplib::Error::ExceedRedirectCount:
+        error_msg = "Too many redirects";
+        break;
+    case httplib::Error::Canceled:
+        error_msg = "Request was canceled";
+        break;
+    case httplib::Error::SSLConnection:
+        error_msg = "SSL connection failed";
+        break;
+    case httplib::Error::SSLLoadingCerts:
+        error_msg = "SSL certificate loading failed";
+        break;
+    case httplib::Error::SSLServerVerification:
+        error_msg = "SSL server verification failed";
+        break;
+    case httplib::Error::UnsupportedMultipartBoundaryChars:
+        error_msg = "Unsupported multipart boundary characters";
+        break;
+    default:
+        error_msg = "Unknown connection error";
+        break;
+    }
 
-                        // Render the document to calculate layout
-                        this->document->render(window_width);
+    return "<html><body><h1>Connection Error</h1><p>" + error_msg + "</p><p>URL: " + url.to_str() + "</p></body></html>";
+}
 
-                        std::cout << "LiteHTML document loaded and rendered successfully!" << std::endl;
-                    }
-                    else {
-                        std::cout << "Failed to create LiteHTML document" << std::endl;
-                        this->current_html = "<html><body><h1>Error</h1><p>Failed to parse HTML document</p></body></html>";
-                    }
-                }
-                catch (const std::exception& e) {
-                    std::cout << "Exception creating LiteHTML document: " << e.what() << std::endl;
-                    this->current_html = "<html><body><h1>Parse Error</h1><p>Failed to parse HTML: " + std::string(e.what()) + "</p></body></html>";
-                }
-            }
-            else if (res->status >= 300 && res->status < 400) {
-                std::cout << "Redirect status: " << res->status << std::endl;
-                // httplib should handle redirects automatically, but if we get here it means redirect failed
-                this->current_html = "<html><body><h1>Redirect Error</h1><p>Too many redirects or redirect failed</p></body></html>";
-            }
-            else {
-                std::cout << "HTTP Error: " << res->status << std::endl;
-                this->current_html = "<html><body><h1>HTTP Error " + std::to_string(res->status) + "</h1><p>Failed to load page</p></body></html>";
-            }
-        }
-        else {
-            auto err = res.error();
-            std::cout << "Connection error: " << httplib::to_string(err) << std::endl;
-
-            std::string error_msg;
-            switch (err) {
-            case httplib::Error::Connection:
-                error_msg = "Connection failed - check if the server is reachable";
-                break;
-            case httplib::Error::BindIPAddress:
-                error_msg = "Failed to bind IP address";
-                break;
-            case httplib::Error::Read:
-                error_msg = "Read timeout or connection lost";
-                break;
-            case httplib::Error::Write:
-                error_msg = "Write timeout or connection lost";
-                break;
-            case httplib::Error::ExceedRedirectCount:
-                error_msg = "Too many redirects";
-                break;
-            case httplib::Error::Canceled:
-                error_msg = "Request was canceled";
-                break;
-            case httplib::Error::SSLConnection:
-                error_msg = "SSL connection failed";
-                break;
-            case httplib::Error::SSLLoadingCerts:
-                error_msg = "SSL certificate loading failed";
-                break;
-            case httplib::Error::SSLServerVerification:
-                error_msg = "SSL server verification failed";
-                break;
-            case httplib::Error::UnsupportedMultipartBoundaryChars:
-                error_msg = "Unsupported multipart boundary characters";
-                break;
-            default:
-                error_msg = "Unknown connection error";
-                break;
-            }
+std::shared_ptr<litehtml::document> NFX_Browser::create_document(const char* html, size_t length, const std::string& page_url, int width, bool partial)
+{
+    // Overlapping navigations build their documents one at a time; the
+    // base URL and image srcs are kept per page by the container
+    std::lock_guard<std::mutex> lock(this->parse_mutex);
+
+    std::string error_html;
 
-            this->current_html = "<html><body><h1>Connection Error</h1><p>" + error_msg + "</p><p>URL: " + url.to_str() + "</p></body></html>";
+    try {
+        // Create litehtml document with default CSS
+        this->container->set_base_url(page_url.c_str());
+
+        auto doc = litehtml::document::createFromString(
+            html,
+            length,
+            this->container,
+            this->master_css,
+            this->default_css
+        );
+
+        if (doc) {
+            // Render the document to calculate layout
+            doc->render(width);
+            return doc;
         }
 
+        std::cout << "Failed to create LiteHTML document" << std::endl;
+        error_html = "<html><body><h1>Error</h1><p>Failed to parse HTML document</p></body></html>";
     }
     catch (const std::exception& e) {
-        std::cout << "Exception during load: " << e.what() << std::endl;
-        this->current_html = "<html><body><h1>Exception</h1><p>Error loading page: " + std::string(e.what()) + "</p></body></html>";
+        std::cout << "Exception creating LiteHTML document: " << e.what() << std::endl;
+        error_html = "<html><body><h1>Parse Error</h1><p>Failed to parse HTML: " + std::string(e.what()) + "</p></body></html>";
     }
     catch (...) {
-        std::cout << "Unknown exception during load" << std::endl;
-        this->current_html = "<html><body><h1>Unknown Error</h1><p>An unknown error occurred while loading the page</p></body></html>";
+        std::cout << "Unknown exception creating LiteHTML document" << std::endl;
+        error_html = "<html><body><h1>Unknown Error</h1><p>An unknown error occurred while loading the page</p></body></html>";
     }
 
-    if (!this->document && !this->current_html.empty()) {
-        try {
-            std::string css = get_default_css();
-            this->document = litehtml::document::createFromString(
-                this->current_html.c_str(),
-                this->container,
-                litehtml::master_css,
-                css.c_str()
-            );
-
-            if (this->document) {
-                int window_width = 800;
-                int window_height = 600;
-                SDL_GetWindowSize(this->window, &window_width, &window_height);
-                this->document->render(window_width);
-            }
+    // The previous document stays up; the final parse decides whether the load failed
+    if (partial) return nullptr;
+
+    try {
+        auto doc = litehtml::document::createFromString(
+            error_html.c_str(),
+            this->container,
+            this->master_css,
+            this->default_css
+        );
+
+        if (doc) {
+            doc->render(width);
         }
-        catch (...) {
-            std::cout << "Failed to create error page document" << std::endl;
+        return doc;
+    }
+    catch (...) {
+        std::cout << "Failed to create error page document" << std::endl;
+    }
+
+    return nullptr;
+}
+
+void NFX_Browser::publish_document(std::shared_ptr<litehtml::document> doc, const std::string& page_url, uint64_t navigation)
+{
+    std::lock_guard<std::mutex> lock(this->pending_mutex);
+
+    // Documents release their fonts when destroyed, which touches the glyph
+    // atlas; ones that are never shown go back to the UI thread to die there
+    if (navigation != this->navigation_id) {
+        this->retired_documents.push_back(std::move(doc));
+        this->wake();
+        return;
+    }
+    if (this->pending_document) {
+        this->retired_documents.push_back(std::move(this->pending_document));
+    }
+
+    this->pending_document = std::move(doc);
+    this->pending_base_url = page_url;
+    this->pending_navigation = navigation;
+    this->wake();
+}
+
+void NFX_Browser::adopt_pending_document()
+{
+    std::shared_ptr<litehtml::document> previous;
+    std::vector<std::shared_ptr<litehtml::document>> retired;
+
+    {
+        std::lock_guard<std::mutex> lock(this->pending_mutex);
+        retired.swap(this->retired_documents);
+        if (!this->pending_document) return;
+
+        previous = std::move(this->document);
+        this->document = std::move(this->pending_document);
+        this->base_url = std::move(this->pending_base_url);
+        this->pending_document = nullptr;
+        this->display_list_valid = false;
+        this->invalidate_page();
+
+        // Images of the page going away may now be evicted
+        if (this->pending_navigation != this->displayed_navigation) {
+            this->resource_cache->release_page(this->displayed_navigation);
+            this->container->release_page(this->displayed_navigation);
+            this->displayed_navigation = this->pending_navigation;
+            this->container->set_page(this->displayed_navigation);
         }
     }
+
+    // The window may have been resized while the document was laid out
+    int window_width = 800;
+    int window_height = 600;
+    SDL_GetWindowSize(this->window, &window_width, &window_height);
+    if (this->document->render_width() != window_width) {
+        this->relayout_to_window();
+    }
+
+    // The old and retired documents are released here, on the UI thread, together with their fonts
 }
 
 void NFX_Browser::renderSimpleText(TTF_Font* font, const char* text, int x, int y)
 {
     if (!this->renderer || !text || !font) return;
     SDL_Color black = { 0, 0, 0, 255 };
-    SDL_Surface* surface = TTF_RenderText_Solid(font, text, black);
+    SDL_Surface* surface = nullptr;
+    {
+        auto font_lock = this->container->lock_font(font);
+        surface = TTF_RenderText_Solid(font, text, black);
+    }
     if (!surface) return;
     SDL_Texture* texture = SDL_CreateTextureFromSurface(this->renderer, surface);
     if (texture)
@@ -282,34 +448,121 @@ void NFX_Browser::renderSimpleText(TTF_Font* font, const char* text, int x, int
     SDL_FreeSurface(surface);
 }
 
+void NFX_Browser::wake()
+{
+    // One queued event is enough to get render() called
+    if (this->wake_event == (Uint32)-1 || this->wake_pending.exchange(true)) return;
+
+    SDL_Event event;
+    SDL_zero(event);
+    event.type = this->wake_event;
+    SDL_PushEvent(&event);
+}
+
+void NFX_Browser::request_redraw()
+{
+    this->redraw_requested = true;
+}
+
+void NFX_Browser::invalidate_page()
+{
+    this->damage.emplace_back(0, 0, INT_MAX / 2, INT_MAX / 2);
+}
+
+Uint32 NFX_Browser::get_wait_timeout()
+{
+    // Decoded images left over from the last frame's upload budget
+    if (this->container->has_pending_uploads()) return 0;
+
+    if (this->resize_pending) {
+        Uint32 now = SDL_GetTicks();
+        Uint32 deadline = std::min(this->resize_last_ticks + RESIZE_DEBOUNCE_MS, this->resize_first_ticks + RESIZE_MAX_DELAY_MS);
+        return (Sint32)(deadline - now) > 0 ? deadline - now : 0;
+    }
+
+    // Workers wake the loop themselves, this only bounds how long it sleeps
+    return IDLE_WAIT_MS;
+}
+
 void NFX_Browser::render()
 {
     extern bool searchBarActive;
     extern std::string searchText;
 
     if (!this->renderer) return;
+    this->wake_pending = false;
 
-    // Clear screen with white background
-    SDL_SetRenderDrawColor(this->renderer, 255, 255, 255, 255);
-    SDL_RenderClear(this->renderer);
+    // Swap in a document that finished loading in the background
+    this->adopt_pending_document();
 
-    // Render the HTML document if available
-    if (this->document) {
-        try {
-            litehtml::position clip(0, 0, 0, 0);
-            this->container->get_client_rect(clip);
+    // Lay the page out again once the window stopped changing size
+    if (this->resize_pending) {
+        Uint32 now = SDL_GetTicks();
+        if (now - this->resize_last_ticks >= RESIZE_DEBOUNCE_MS || now - this->resize_first_ticks >= RESIZE_MAX_DELAY_MS) {
+            this->resize_pending = false;
+            this->relayout_to_window();
+        }
+    }
 
-            // Draw the document
-            this->document->draw(reinterpret_cast<litehtml::uint_ptr>(this->renderer), 0, 0, &clip);
+    // Textures are created and evicted on the render thread only
+    // Images that arrived this frame share one relayout
+    litehtml::string_vector loaded_images;
+    this->container->upload_images(loaded_images);
+    if (this->document && !loaded_images.empty()) {
+        // Background layers were recorded with the placeholder size
+        this->display_list_valid = false;
+        try {
+            this->document->on_images_loaded(loaded_images, this->damage);
         }
         catch (const std::exception& e) {
-            std::cout << "Exception during render: " << e.what() << std::endl;
+            std::cout << "Exception during image relayout: " << e.what() << std::endl;
         }
-        catch (...) {
-            std::cout << "Unknown exception during render" << std::endl;
+    }
+    this->resource_cache->trim();
+
+    // Nothing on screen changed since the last frame
+    if (this->damage.empty() && !this->redraw_requested) return;
+    this->redraw_requested = false;
+
+    int output_width = 0;
+    int output_height = 0;
+    SDL_GetRendererOutputSize(this->renderer, &output_width, &output_height);
+    SDL_Rect viewport = { 0, 0, output_width, output_height };
+
+    // The page is kept in a texture so only its damaged parts are painted again.
+    // Without render targets every frame repaints the whole window.
+    if (this->page_texture && (this->page_texture_width != output_width || this->page_texture_height != output_height)) {
+        SDL_DestroyTexture(this->page_texture);
+        this->page_texture = nullptr;
+    }
+    if (!this->page_texture && SDL_RenderTargetSupported(this->renderer)) {
+        this->page_texture = SDL_CreateTexture(this->renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, output_width, output_height);
+        this->page_texture_width = output_width;
+        this->page_texture_height = output_height;
+        this->invalidate_page();
+    }
+
+    if (this->page_texture) {
+        std::vector<SDL_Rect> areas;
+        this->get_damaged_areas(viewport, areas);
+
+        SDL_SetRenderTarget(this->renderer, this->page_texture);
+        for (const SDL_Rect& area : areas) {
+            SDL_RenderSetClipRect(this->renderer, &area);
+            this->paint_page(area);
         }
+        SDL_RenderSetClipRect(this->renderer, nullptr);
+        SDL_SetRenderTarget(this->renderer, nullptr);
+
+        SDL_RenderCopy(this->renderer, this->page_texture, nullptr, nullptr);
+    }
+    else {
+        this->paint_page(viewport);
     }
 
+    // Text runs not drawn this frame are off screen and may be evicted
+    this->container->end_frame();
+
     // Render search bar if active
     if (searchBarActive) {
         // Simple search bar rendering
@@ -322,6 +575,52 @@ void NFX_Browser::render()
     }
 
     SDL_RenderPresent(this->renderer);
+    this->damage.clear();
+}
+
+void NFX_Browser::paint_page(const SDL_Rect& area)
+{
+    // Clear with white background
+    SDL_SetRenderDrawColor(this->renderer, 255, 255, 255, 255);
+    SDL_RenderFillRect(this->renderer, &area);
+
+    // Render the HTML document if available
+    if (!this->document) return;
+
+    try {
+        if (!this->display_list_valid) {
+            this->container->record(this->document, this->display_list);
+            this->display_list_valid = true;
+        }
+
+        // Draw the part of the document in the area
+        this->container->replay(this->display_list, area);
+    }
+    catch (const std::exception& e) {
+        std::cout << "Exception during render: " << e.what() << std::endl;
+    }
+    catch (...) {
+        std::cout << "Unknown exception during render" << std::endl;
+    }
+}
+
+void NFX_Browser::get_damaged_areas(const SDL_Rect& viewport, std::vector<SDL_Rect>& areas)
+{
+    SDL_Rect bounds = { 0, 0, 0, 0 };
+    for (const auto& box : this->damage) {
+        SDL_Rect rect = { box.x, box.y, box.width, box.height };
+        SDL_Rect visible;
+        if (!SDL_IntersectRect(&rect, &viewport, &visible)) continue;
+
+        areas.push_back(visible);
+        SDL_UnionRect(&bounds, &visible, &bounds);
+    }
+
+    // Many small areas cost more in replay passes than painting their bounds once
+    if (areas.size() > MAX_DAMAGED_AREAS) {
+        areas.clear();
+        areas.push_back(bounds);
+    }
 }
 
 void NFX_Browser::on_anchor_click(const std::string& url)
@@ -343,6 +642,92 @@ void NFX_Browser::on_anchor_click(const std::string& url)
     }
 }
 
+void NFX_Browser::relayout_after_restyle()
+{
+    // Hover and active rules may change sizes, not just colors.
+    // A pending resize is left to relayout_to_window.
+    int old_width = this->document->width();
+    int old_height = this->document->height();
+    this->document->render(this->document->render_width());
+
+    // litehtml already put the restyled boxes into damage. If nothing moved,
+    // the new recording differs from the old one only in how some items are
+    // painted, and those items are damaged too; otherwise repaint everything.
+    NFX_DisplayList updated;
+    this->container->record(this->document, updated);
+    bool same_layout = this->display_list_valid &&
+        this->document->width() == old_width && this->document->height() == old_height &&
+        this->display_list.same_layout(updated, this->damage);
+
+    std::swap(this->display_list, updated);
+    this->display_list_valid = true;
+    if (!same_layout) {
+        this->invalidate_page();
+    }
+}
+
+void NFX_Browser::relayout_to_window()
+{
+    if (!this->document) return;
+
+    int window_width = 800;
+    int window_height = 600;
+    SDL_GetWindowSize(this->window, &window_width, &window_height);
+
+    try {
+        // Only elements matched by rules under a media query that flipped are restyled,
+        // and boxes whose containing block kept its size keep their layout
+        this->document->media_changed();
+        this->document->render(window_width);
+        this->display_list_valid = false;
+        this->invalidate_page();
+    }
+    catch (const std::exception& e) {
+        std::cout << "Exception during resize relayout: " << e.what() << std::endl;
+    }
+}
+
+void NFX_Browser::handle_resize()
+{
+    // The window shows the old layout at the new size until the relayout
+    this->redraw_requested = true;
+
+    Uint32 now = SDL_GetTicks();
+    if (!this->resize_pending) {
+        this->resize_pending = true;
+        this->resize_first_ticks = now;
+    }
+    this->resize_last_ticks = now;
+}
+
+void NFX_Browser::handle_mouse_move(int x, int y)
+{
+    if (!this->document) return;
+
+    try {
+        if (this->document->on_mouse_over(x, y, x, y, this->damage)) {
+            this->relayout_after_restyle();
+        }
+    }
+    catch (const std::exception& e) {
+        std::cout << "Exception in handle_mouse_move: " << e.what() << std::endl;
+    }
+}
+
+void NFX_Browser::handle_mouse_leave()
+{
+    if (!this->document) return;
+
+    try {
+        if (this->document->on_mouse_leave(this->damage)) {
+            this->relayout_after_restyle();
+        }
+    }
+    catch (const std::exception& e) {
+        std::cout << "Exception in handle_mouse_leave: " << e.what() << std::endl;
+    }
+}
+
 std::shared_ptr<litehtml::element> find_element_at(std::shared_ptr<litehtml::element> root, int x, int y)
 {
     if (!root) return nullptr;
@@ -371,8 +756,9 @@ void NFX_Browser::handle_click(int x, int y)
     if (!this->document) return;
 
     try {
-        litehtml::position::vector redraw_boxes;
-        this->document->on_lbutton_down(x, y, 0, 0, redraw_boxes);
+        if (this->document->on_lbutton_down(x, y, x, y, this->damage)) {
+            this->relayout_after_restyle();
+        }
 
         auto root = this->document->root();
         auto clicked_element = find_element_at(root, x, y);
@@ -413,10 +799,6 @@ void NFX_Browser::handle_click(int x, int y)
                 current_element = current_element->parent();
             }
         }
-
-        for (const auto& box : redraw_boxes) {
-            // Optional: implement partial redraws
-        }
     }
     catch (const std::exception& e) {
         std::cout << "Exception in handle_click: " << e.what() << std::endl;
@@ -1,110 +1,16 @@
 #pragma once
 
 #include <string>
+#include <atomic>
+#include <mutex>
 #include <litehtml.h>
 #include "renderer/container.h"
+#include "url.h"
+#include "net/connection_pool.h"
+#include "net/fetch_scheduler.h"
+#include "net/preload_scanner.h"
 #include <SDL.h>
-
-class NFX_Url
-{
-public:
-    std::string schema;
-    std::string hostname;
-    std::string path;
-    int port;
-
-    NFX_Url(std::string& url) {
-        parse_url(url);
-    }
-
-    std::string to_str() {
-        std::string result = schema + "://" + hostname;
-
-        // Add port if it's not the default
-        if ((schema == "http" && port != 80) ||
-            (schema == "https" && port != 443)) {
-            result += ":" + std::to_string(port);
-        }
-
-        result += path;
-        return result;
-    }
-
-    bool is_https() {
-        return schema == "https";
-    }
-
-    bool is_valid() {
-        return !schema.empty() && !hostname.empty();
-    }
-
-private:
-    void parse_url(const std::string& url) {
-        // Default values
-        schema = "";
-        hostname = "";
-        path = "/";
-        port = 80;
-
-        if (url.empty()) return;
-
-        std::string remaining = url;
-
-        // Extract schema
-        size_t schema_pos = remaining.find("://");
-        if (schema_pos != std::string::npos) {
-            schema = remaining.substr(0, schema_pos);
-            remaining = remaining.substr(schema_pos + 3);
-
-            // Set default port based on schema
-            if (schema == "https") {
-                port = 443;
-            }
-            else if (schema == "http") {
-                port = 80;
-            }
-        }
-        else {
-            // No schema, assume http
-            schema = "http";
-            port = 80;
-        }
-
-        // Extract hostname and optional port
-        size_t path_pos = remaining.find('/');
-        std::string host_part;
-
-        if (path_pos != std::string::npos) {
-            host_part = remaining.substr(0, path_pos);
-            path = remaining.substr(path_pos);
-        }
-        else {
-            host_part = remaining;
-            path = "/";
-        }
-
-        // Check for port in hostname
-        size_t port_pos = host_part.find(':');
-        if (port_pos != std::string::npos) {
-            hostname = host_part.substr(0, port_pos);
-            std::string port_str = host_part.substr(port_pos + 1);
-            try {
-                port = std::stoi(port_str);
-            }
-            catch (...) {
-                // Invalid port, keep default
-            }
-        }
-        else {
-            hostname = host_part;
-        }
-
-        // Ensure path starts with '/'
-        if (!path.empty() && path[0] != '/') {
-            path = "/" + path;
-        }
-    }
-};
+#include "../bytesize.h"
 
 class NFX_Browser
 {
@@ -112,18 +18,110 @@ private:
     SDL_Window* window;
     SDL_Renderer* renderer;
     NFX_Container* container;
+    NFX_ConnectionPool* connection_pool;
+    NFX_FetchScheduler* fetch_scheduler;
+    NFX_HttpCache* http_cache;
+    NFX_ResourceCache* resource_cache;
+
+    // Disk space the HTTP cache may use before evicting
+    static const uint64_t HTTP_CACHE_BUDGET = 256 * MiB;
+
+    // Memory the decoded resource cache may keep for pages no longer shown
+    static const size_t RESOURCE_ENCODED_BUDGET = 32 * MiB;
+    static const size_t RESOURCE_TEXTURE_BUDGET = 128 * MiB;
     std::shared_ptr<litehtml::document> document;
-    std::string current_html;
     std::string base_url;
 
+    // Areas of the page changed since the last frame
+    litehtml::position::vector damage;
+
+    // What the document paints, recorded again only after layout or style changed
+    NFX_DisplayList display_list;
+    bool display_list_valid = false;
+
+    // The painted page, kept between frames so only damaged areas are painted again
+    SDL_Texture* page_texture = nullptr;
+    int page_texture_width = 0;
+    int page_texture_height = 0;
+    bool redraw_requested = true;
+
+    // More damaged areas than this are painted as their bounding box
+    static const size_t MAX_DAMAGED_AREAS = 8;
+
+    // Event pushed by workers so the main loop wakes up to show their results
+    Uint32 wake_event = (Uint32)-1;
+    std::atomic<bool> wake_pending{ false };
+
+    // Upper bound on how long the main loop sleeps without events
+    static const Uint32 IDLE_WAIT_MS = 1000;
+
+    // Resize events arrive continuously while dragging; the layout follows once they pause,
+    // and at least every RESIZE_MAX_DELAY_MS so a long drag does not show a stale page
+    static const Uint32 RESIZE_DEBOUNCE_MS = 50;
+    static const Uint32 RESIZE_MAX_DELAY_MS = 250;
+    bool resize_pending = false;
+    Uint32 resize_first_ticks = 0;
+    Uint32 resize_last_ticks = 0;
+
+    // Body of the page being streamed in, shared by the fetch callbacks
+    struct StreamingPage {
+        int status = 0;
+        std::string html;
+        size_t next_partial_size = 16 * KiB;
+        std::unique_ptr<NFX_PreloadScanner> scanner;
+        int images_seen = 0;
+    };
+
+    // Images found this early are assumed to be in the first viewport
+    static const int PRELOAD_VISIBLE_IMAGES = 6;
+
+    // Navigation results handed over from the loading thread
+    std::atomic<uint64_t> navigation_id{ 0 };
+    std::shared_ptr<litehtml::document> pending_document;
+    std::string pending_base_url;
+    uint64_t pending_navigation = 0;
+    std::vector<std::shared_ptr<litehtml::document>> retired_documents;
+    std::mutex pending_mutex;
+
+    // Pages whose resources are pinned in the resource cache
+    uint64_t displayed_navigation = 0;
+    uint64_t loading_navigation = 0;
+    std::mutex parse_mutex;
+
     // Default CSS for basic styling
     std::string get_default_css();
+
+    // Parsed once at startup and shared by every document
+    litehtml::css::const_ptr master_css;
+    litehtml::css::const_ptr default_css;
     void renderSimpleText(TTF_Font* font, const char* text, int x, int y);
+
+    std::string get_response_html(httplib::Result& res, const NFX_Url& url);
+    // A partial document that fails to parse yields nullptr instead of an error page
+    std::shared_ptr<litehtml::document> create_document(const char* html, size_t length, const std::string& page_url, int width, bool partial = false);
+    void publish_document(std::shared_ptr<litehtml::document> doc, const std::string& page_url, uint64_t navigation);
+    void adopt_pending_document();
+    void relayout_after_restyle();
+    void relayout_to_window();
+    void paint_page(const SDL_Rect& area);
+    void get_damaged_areas(const SDL_Rect& viewport, std::vector<SDL_Rect>& areas);
 public:
     NFX_Browser(SDL_Window* window);
     ~NFX_Browser();
     void load(NFX_Url& url);
+    // Does pending work and paints what changed; returns early when nothing did
     void render();
+    // How long the main loop may wait for events before render() has timed work
+    Uint32 get_wait_timeout();
+    // May be called from any thread
+    void wake();
+    // Presents the window again without repainting the page, e.g. for the search bar
+    void request_redraw();
+    // Repaints the whole page, e.g. after the renderer lost its textures
+    void invalidate_page();
     void on_anchor_click(const std::string& url);
     void handle_click(int x, int y);
+    void handle_mouse_move(int x, int y);
+    void handle_mouse_leave();
+    void handle_resize();
 };
\ No newline at end of file
@@ -0,0 +1,144 @@
+#include "connection_pool.h"
+#include <algorithm>
+
+NFX_ConnectionPool::Lease::Lease(NFX_ConnectionPool* pool, std::string key, std::unique_ptr<httplib::Client> client)
+    : pool(pool), key(std::move(key)), client(std::move(client))
+{
+}
+
+NFX_ConnectionPool::Lease::Lease(Lease&& other) noexcept
+    : pool(other.pool), key(std::move(other.key)), client(std::move(other.client)), reusable(other.reusable)
+{
+    other.pool = nullptr;
+}
+
+NFX_ConnectionPool::Lease& NFX_ConnectionPool::Lease::operator=(Lease&& other) noexcept
+{
+    if (this != &other) {
+        if (pool && client) {
+            pool->release(key, std::move(client), reusable);
+        }
+        pool = other.pool;
+        key = std::move(other.key);
+        client = std::move(other.client);
+        reusable = other.reusable;
+        other.pool = nullptr;
+    }
+    return *this;
+}
+
+NFX_ConnectionPool::Lease::~Lease()
+{
+    if (pool && client) {
+        pool->release(key, std::move(client), reusable);
+    }
+}
+
+NFX_ConnectionPool::~NFX_ConnectionPool()
+{
+    clear();
+}
+
+std::unique_ptr<httplib::Client> NFX_ConnectionPool::create_client(const NFX_Url& url)
+{
+    auto client = std::make_unique<httplib::Client>(url.schema + "://" + url.hostname + ":" + std::to_string(url.port));
+
+    client->set_keep_alive(true);
+    client->enable_server_certificate_verification(false);
+
+    // Set timeouts
+    client->set_connection_timeout(10, 0);  // 10 seconds
+    client->set_read_timeout(15, 0);        // 15 seconds
+    client->set_write_timeout(10, 0);       // 10 seconds
+
+    return client;
+}
+
+NFX_ConnectionPool::Lease NFX_ConnectionPool::acquire(const NFX_Url& url)
+{
+    std::string key = url.origin();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        evict_expired(std::chrono::steady_clock::now());
+
+        auto it = idle.find(key);
+        if (it != idle.end() && !it->second.empty()) {
+            // Most recently used first, it is the least likely to have been closed by the server
+            std::unique_ptr<httplib::Client> client = std::move(it->second.back().client);
+            it->second.pop_back();
+            idle_count--;
+            return Lease(this, key, std::move(client));
+        }
+    }
+
+    return Lease(this, key, create_client(url));
+}
+
+void NFX_ConnectionPool::release(const std::string& key, std::unique_ptr<httplib::Client> client, bool reusable)
+{
+    if (!reusable || !client || !client->is_socket_open()) return;
+
+    // Reset per-request settings so the next user starts from the defaults
+    client->set_follow_location(false);
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto& list = idle[key];
+    if (list.size() >= MAX_IDLE_PER_ORIGIN) return;
+
+    if (idle_count >= MAX_IDLE_TOTAL) {
+        // Drop the oldest idle connection of any origin to make room
+        auto oldest_list = idle.end();
+        for (auto it = idle.begin(); it != idle.end(); ++it) {
+            if (it->second.empty()) continue;
+            if (oldest_list == idle.end() || it->second.front().since < oldest_list->second.front().since) {
+                oldest_list = it;
+            }
+        }
+        if (oldest_list == idle.end()) return;
+        oldest_list->second.erase(oldest_list->second.begin());
+        idle_count--;
+    }
+
+    list.push_back({ std::move(client), std::chrono::steady_clock::now() });
+    idle_count++;
+}
+
+void NFX_ConnectionPool::evict_expired(std::chrono::steady_clock::time_point now)
+{
+    for (auto it = idle.begin(); it != idle.end(); ) {
+        auto& list = it->second;
+        size_t before = list.size();
+        list.erase(std::remove_if(list.begin(), list.end(), [&](const IdleClient& c) {
+            return now - c.since > IDLE_TIMEOUT;
+        }), list.end());
+        idle_count -= before - list.size();
+
+        if (list.empty()) {
+            it = idle.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+}
+
+httplib::Result NFX_ConnectionPool::get(const NFX_Url& url, const httplib::Headers& headers, bool follow_location)
+{
+    Lease lease = acquire(url);
+    lease->set_follow_location(follow_location);
+
+    httplib::Result res = lease->Get(url.path, headers);
+    if (!res) {
+        lease.discard();
+    }
+    return res;
+}
+
+void NFX_ConnectionPool::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    idle.clear();
+    idle_count = 0;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <httplib.hpp>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "../url.h"
+
+// Keeps warm keep-alive clients per origin (scheme + host + port) so page,
+// stylesheet and image fetches reuse TCP and TLS sessions instead of paying
+// a fresh handshake for every request.
+class NFX_ConnectionPool
+{
+public:
+    // Exclusive use of one pooled client. Returned to the pool on destruction
+    // unless discard() was called after a transport error.
+    class Lease
+    {
+    private:
+        NFX_ConnectionPool* pool = nullptr;
+        std::string key;
+        std::unique_ptr<httplib::Client> client;
+        bool reusable = true;
+
+    public:
+        Lease() = default;
+        Lease(NFX_ConnectionPool* pool, std::string key, std::unique_ptr<httplib::Client> client);
+        Lease(Lease&& other) noexcept;
+        Lease& operator=(Lease&& other) noexcept;
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        ~Lease();
+
+        httplib::Client* operator->() const { return client.get(); }
+        explicit operator bool() const { return client != nullptr; }
+        void discard() { reusable = false; }
+    };
+
+private:
+    static const size_t MAX_IDLE_PER_ORIGIN = 6;
+    static const size_t MAX_IDLE_TOTAL = 32;
+    static constexpr std::chrono::seconds IDLE_TIMEOUT{ 30 };
+
+    struct IdleClient {
+        std::unique_ptr<httplib::Client> client;
+        std::chrono::steady_clock::time_point since;
+    };
+
+    std::map<std::string, std::vector<IdleClient>> idle;
+    size_t idle_count = 0;
+    std::mutex mutex;
+
+    std::unique_ptr<httplib::Client> create_client(const NFX_Url& url);
+    void release(const std::string& key, std::unique_ptr<httplib::Client> client, bool reusable);
+    void evict_expired(std::chrono::steady_clock::time_point now);
+
+public:
+    NFX_ConnectionPool() = default;
+    ~NFX_ConnectionPool();
+
+    Lease acquire(const NFX_Url& url);
+
+    // Convenience wrapper: GET on a pooled client, dropping it on transport errors
+    httplib::Result get(const NFX_Url& url, const httplib::Headers& headers, bool follow_location = false);
+
+    // Closes every idle connection
+    void clear();
+};
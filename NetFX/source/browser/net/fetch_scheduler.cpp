@@ -0,0 +1,361 @@
+#include "fetch_scheduler.h"
+#include <iostream>
+#include <algorithm>
+
+namespace
+{
+    // httplib only advertises its decoders when it buffers the body itself, so
+    // streamed requests need the header spelled out; bodies are then inflated
+    // chunk by chunk before they reach on_data
+    const char* accepted_encodings()
+    {
+#if defined(CPPHTTPLIB_BROTLI_SUPPORT) && defined(CPPHTTPLIB_ZLIB_SUPPORT)
+        return "br, gzip, deflate";
+#elif defined(CPPHTTPLIB_BROTLI_SUPPORT)
+        return "br";
+#elif defined(CPPHTTPLIB_ZLIB_SUPPORT)
+        return "gzip, deflate";
+#else
+        return "identity";
+#endif
+    }
+}
+
+NFX_FetchScheduler::NFX_FetchScheduler(NFX_ConnectionPool* pool, NFX_HttpCache* cache)
+    : connection_pool(pool), http_cache(cache)
+{
+    for (int i = 0; i < WORKER_COUNT; i++) {
+        workers.emplace_back(&NFX_FetchScheduler::worker_loop, this);
+    }
+}
+
+NFX_FetchScheduler::~NFX_FetchScheduler()
+{
+    cancel_all();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void NFX_FetchScheduler::submit(NFX_FetchRequest request)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        Job job = {
+            std::move(request),
+            "",
+            generation.load(),
+            std::chrono::steady_clock::now()
+        };
+        if (!job.request.task) job.host_key = job.request.url.origin();
+
+        queues[job.request.priority].push_back(std::move(job));
+
+        stats.queue_depth++;
+        stats.peak_queue_depth = std::max(stats.peak_queue_depth, stats.queue_depth);
+    }
+    wake.notify_one();
+}
+
+void NFX_FetchScheduler::cancel_all()
+{
+    std::vector<Job> dropped;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        // Running jobs notice the new generation from their progress callback
+        generation++;
+
+        for (auto& queue : queues) {
+            for (auto& job : queue) {
+                dropped.push_back(std::move(job));
+            }
+            queue.clear();
+        }
+        stats.cancelled += dropped.size();
+        stats.queue_depth = 0;
+    }
+
+    for (auto& job : dropped) {
+        if (job.request.on_cancel) {
+            job.request.on_cancel();
+        }
+    }
+}
+
+void NFX_FetchScheduler::promote(const std::string& url, NFX_FetchPriority priority)
+{
+    // Compared the way jobs print their URL, so both sides are normalized alike
+    std::string key = NFX_Url(url).to_str();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (int level = priority + 1; level < NFX_FETCH_PRIORITY_COUNT; level++) {
+        auto& queue = queues[level];
+        for (auto it = queue.begin(); it != queue.end(); ++it) {
+            if (it->request.url.to_str() != key) continue;
+
+            it->request.priority = priority;
+            queues[priority].push_back(std::move(*it));
+            queue.erase(it);
+            return;
+        }
+    }
+}
+
+bool NFX_FetchScheduler::take_next(Job& job)
+{
+    // Highest priority class first, skipping hosts that are at their limit
+    for (auto& queue : queues) {
+        for (auto it = queue.begin(); it != queue.end(); ++it) {
+            if (!it->host_key.empty() && host_in_flight[it->host_key] >= MAX_PER_HOST) continue;
+
+            job = std::move(*it);
+            queue.erase(it);
+            return true;
+        }
+    }
+    return false;
+}
+
+void NFX_FetchScheduler::worker_loop()
+{
+    while (true) {
+        // Placeholder until a queued job is moved in
+        Job job = { NFX_FetchRequest(NFX_Url("")), "", 0, {} };
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&]() { return stopping || take_next(job); });
+            if (stopping) return;
+
+            double wait_ms = std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - job.queued_at).count();
+
+            host_in_flight[job.host_key]++;
+            stats.queue_depth--;
+            stats.in_flight++;
+            stats.total_wait_ms += wait_ms;
+            stats.max_wait_ms = std::max(stats.max_wait_ms, wait_ms);
+        }
+
+        run(job);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            host_in_flight[job.host_key]--;
+            stats.in_flight--;
+        }
+        // A host slot opened up, another worker may now be able to proceed
+        wake.notify_all();
+    }
+}
+
+void NFX_FetchScheduler::run(Job& job)
+{
+    auto is_cancelled = [&]() { return job.generation != generation.load(); };
+
+    if (is_cancelled()) {
+        cancel(job);
+        return;
+    }
+
+    if (job.request.task) {
+        job.request.task();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.completed++;
+        return;
+    }
+
+    httplib::Result res;
+    try {
+        res = fetch(job, is_cancelled);
+    }
+    catch (const std::exception& e) {
+        std::cout << "Exception fetching " << job.request.url.to_str() << ": " << e.what() << std::endl;
+        cancel(job);
+        return;
+    }
+
+    if (is_cancelled()) {
+        cancel(job);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.completed++;
+    }
+
+    if (job.request.on_complete) {
+        job.request.on_complete(res);
+    }
+}
+
+httplib::Result NFX_FetchScheduler::fetch(Job& job, const std::function<bool()>& is_cancelled)
+{
+    NFX_Url url = job.request.url;
+
+    // Redirects are followed here rather than by httplib, so every hop goes
+    // through the cache and permanent ones can be remembered
+    for (int redirects = 0; redirects <= MAX_REDIRECTS; redirects++) {
+        std::string key = url.to_str();
+
+        if (http_cache && job.request.follow_location) {
+            std::string target = http_cache->lookup_redirect(key);
+            if (!target.empty()) {
+                url = url.resolve(target);
+                continue;
+            }
+        }
+
+        std::shared_ptr<const NFX_HttpCache::Entry> cached = http_cache ? http_cache->lookup(key) : nullptr;
+        if (cached && cached->is_fresh(NFX_HttpCache::now())) {
+            httplib::Result res = serve_cached(job, *cached, is_cancelled);
+            if (res) return res;
+
+            // The body is gone from disk, fall back to the network
+            cached = nullptr;
+        }
+
+        httplib::Headers headers = job.request.headers;
+        if (headers.find("Accept-Encoding") == headers.end()) {
+            headers.emplace("Accept-Encoding", accepted_encodings());
+        }
+        if (cached) {
+            if (!cached->etag.empty()) headers.emplace("If-None-Match", cached->etag);
+            if (!cached->last_modified.empty()) headers.emplace("If-Modified-Since", cached->last_modified);
+        }
+
+        // Redirects and 304s are handled here; only the final response reaches the caller
+        auto is_final = [&](int status) {
+            bool redirect = status >= 300 && status < 400 && status != 304 && job.request.follow_location;
+            return !redirect && !(status == 304 && cached);
+        };
+
+        httplib::Result res;
+        std::unique_ptr<NFX_HttpCache::BodyWriter> stored_body;
+        {
+            NFX_ConnectionPool::Lease lease = connection_pool->acquire(url);
+            lease->set_follow_location(false);
+
+            auto progress = [&](uint64_t, uint64_t) { return !is_cancelled(); };
+
+            if (job.request.on_data) {
+                bool deliver = false;
+                res = lease->Get(url.path, headers,
+                    [&](const httplib::Response& response) {
+                        deliver = is_final(response.status);
+                        if (!deliver) return true;
+
+                        // The caller consumes the body, the cache copy is written alongside
+                        if (http_cache && NFX_HttpCache::is_storable(response)) {
+                            stored_body = http_cache->begin_store(key, response);
+                        }
+                        return !job.request.on_response || job.request.on_response(response);
+                    },
+                    [&](const char* data, size_t length) {
+                        if (!deliver) return true;
+                        if (stored_body && !stored_body->append(data, length)) stored_body.reset();
+                        return !is_cancelled() && job.request.on_data(data, length);
+                    },
+                    progress);
+            }
+            else {
+                res = lease->Get(url.path, headers, progress);
+            }
+
+            if (!res) {
+                lease.discard();
+                return res;
+            }
+        }
+
+        if (res->status == 304 && cached) {
+            http_cache->revalidated(key, *res);
+            httplib::Result cached_res = serve_cached(job, *cached, is_cancelled);
+            return cached_res ? std::move(cached_res) : std::move(res);
+        }
+
+        if (!is_final(res->status)) {
+            std::string location = res->get_header_value("Location");
+            if (location.empty()) return res;
+
+            if (http_cache && (res->status == 301 || res->status == 308)) {
+                http_cache->store_redirect(key, *res, location);
+            }
+            url = url.resolve(location);
+            continue;
+        }
+
+        if (http_cache && res->status == 200 && !is_cancelled()) {
+            if (!job.request.on_data && NFX_HttpCache::is_storable(*res)) {
+                http_cache->store(key, *res, res->body);
+            }
+            else if (stored_body) {
+                http_cache->commit(std::move(stored_body));
+            }
+        }
+
+        return res;
+    }
+
+    return httplib::Result(std::unique_ptr<httplib::Response>(), httplib::Error::ExceedRedirectCount);
+}
+
+httplib::Result NFX_FetchScheduler::serve_cached(Job& job, const NFX_HttpCache::Entry& entry, const std::function<bool()>& is_cancelled)
+{
+    std::unique_ptr<httplib::detail::mmap> body = http_cache->open_body(entry);
+    if (!body) return httplib::Result();
+
+    auto response = std::make_unique<httplib::Response>();
+    response->status = entry.status;
+    response->headers = entry.headers;
+
+    if (job.request.on_data) {
+        // Stream straight out of the mapping, no intermediate copy
+        if (job.request.on_response && !job.request.on_response(*response)) {
+            return httplib::Result(std::move(response), httplib::Error::Canceled);
+        }
+
+        const size_t CHUNK = 64 * 1024;
+        for (size_t offset = 0; offset < body->size(); offset += CHUNK) {
+            size_t length = std::min(CHUNK, body->size() - offset);
+            if (is_cancelled() || !job.request.on_data(body->data() + offset, length)) {
+                return httplib::Result(std::move(response), httplib::Error::Canceled);
+            }
+        }
+    }
+    else {
+        response->body.assign(body->data(), body->size());
+    }
+
+    return httplib::Result(std::move(response), httplib::Error::Success);
+}
+
+void NFX_FetchScheduler::cancel(Job& job)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.cancelled++;
+    }
+
+    if (job.request.on_cancel) {
+        job.request.on_cancel();
+    }
+}
+
+NFX_FetchScheduler::Stats NFX_FetchScheduler::get_stats()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <httplib.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../url.h"
+#include "connection_pool.h"
+#include "http_cache.h"
+
+// Lower values are served first
+enum NFX_FetchPriority
+{
+    NFX_FETCH_DOCUMENT = 0,
+    NFX_FETCH_STYLESHEET,
+    NFX_FETCH_VISIBLE_IMAGE,
+    NFX_FETCH_OFFSCREEN_IMAGE,
+    NFX_FETCH_PRIORITY_COUNT
+};
+
+struct NFX_FetchRequest
+{
+    NFX_Url url;
+    httplib::Headers headers;
+    NFX_FetchPriority priority = NFX_FETCH_VISIBLE_IMAGE;
+    bool follow_location = false;
+
+    // Runs on a worker thread; never called for cancelled jobs
+    std::function<void(httplib::Result& res)> on_complete;
+
+    // Runs instead of on_complete when the job is cancelled
+    std::function<void()> on_cancel;
+
+    // Optional streaming. When on_data is set the body is handed over chunk
+    // by chunk as it arrives and res->body stays empty; on_response sees the
+    // final status and headers first. Returning false aborts the transfer.
+    std::function<bool(const httplib::Response& res)> on_response;
+    std::function<bool(const char* data, size_t length)> on_data;
+
+    // CPU work such as decoding, queued and cancelled like a fetch. When set it
+    // runs on a worker instead of any network access, on_complete is not
+    // called and the URL only serves promote(); no host limit applies.
+    std::function<void()> task;
+
+    NFX_FetchRequest(const NFX_Url& url) : url(url) {}
+};
+
+// Runs fetches on a fixed set of worker threads with per-host concurrency
+// limits and priority classes. Everything queued or in flight can be
+// cancelled at once when the browser navigates away.
+class NFX_FetchScheduler
+{
+public:
+    struct Stats {
+        size_t queue_depth = 0;
+        size_t peak_queue_depth = 0;
+        size_t in_flight = 0;
+        uint64_t completed = 0;
+        uint64_t cancelled = 0;
+        double total_wait_ms = 0.0;
+        double max_wait_ms = 0.0;
+
+        double average_wait_ms() const {
+            return completed ? total_wait_ms / completed : 0.0;
+        }
+    };
+
+private:
+    static const int WORKER_COUNT = 6;
+    static const int MAX_PER_HOST = 4;
+    static const int MAX_REDIRECTS = 10;
+
+    struct Job {
+        NFX_FetchRequest request;
+        std::string host_key;
+        uint64_t generation;
+        std::chrono::steady_clock::time_point queued_at;
+    };
+
+    NFX_ConnectionPool* connection_pool;
+    NFX_HttpCache* http_cache;
+    std::vector<std::thread> workers;
+    std::deque<Job> queues[NFX_FETCH_PRIORITY_COUNT];
+    std::map<std::string, int> host_in_flight;
+    std::atomic<uint64_t> generation{ 0 };
+    bool stopping = false;
+    Stats stats;
+    std::mutex mutex;
+    std::condition_variable wake;
+
+    void worker_loop();
+    bool take_next(Job& job);
+    void run(Job& job);
+    httplib::Result fetch(Job& job, const std::function<bool()>& is_cancelled);
+    httplib::Result serve_cached(Job& job, const NFX_HttpCache::Entry& entry, const std::function<bool()>& is_cancelled);
+    void cancel(Job& job);
+
+public:
+    // cache may be null to always go to the network
+    NFX_FetchScheduler(NFX_ConnectionPool* pool, NFX_HttpCache* cache);
+    ~NFX_FetchScheduler();
+
+    void submit(NFX_FetchRequest request);
+
+    // Drops queued jobs and aborts running ones; only their on_cancel callbacks fire
+    void cancel_all();
+
+    // Moves a queued fetch of url up to the given class; does nothing once it started
+    void promote(const std::string& url, NFX_FetchPriority priority);
+
+    Stats get_stats();
+};
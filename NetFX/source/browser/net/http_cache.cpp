@@ -0,0 +1,497 @@
+#include "http_cache.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    std::string to_lower(std::string str)
+    {
+        for (char& c : str) {
+            c = (char)std::tolower((unsigned char)c);
+        }
+        return str;
+    }
+
+    // Finds "name" or "name=value" in a Cache-Control header
+    bool find_directive(const std::string& cache_control, const char* name, std::string* value = nullptr)
+    {
+        std::stringstream ss(cache_control);
+        std::string item;
+        while (std::getline(ss, item, ',')) {
+            size_t start = item.find_first_not_of(" \t");
+            if (start == std::string::npos) continue;
+            item = item.substr(start);
+
+            size_t eq = item.find('=');
+            std::string key = item.substr(0, eq);
+            key.erase(key.find_last_not_of(" \t") + 1);
+
+            if (key == name) {
+                if (value && eq != std::string::npos) {
+                    *value = item.substr(eq + 1);
+                    value->erase(std::remove(value->begin(), value->end(), '"'), value->end());
+                }
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Days since 1970-01-01 for a proleptic Gregorian date
+    int64_t days_from_civil(int64_t y, unsigned m, unsigned d)
+    {
+        y -= m <= 2;
+        const int64_t era = (y >= 0 ? y : y - 399) / 400;
+        const unsigned yoe = (unsigned)(y - era * 400);
+        const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+        const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+        return era * 146097 + (int64_t)doe - 719468;
+    }
+}
+
+NFX_HttpCache::NFX_HttpCache(const std::string& directory, uint64_t max_bytes)
+    : directory(directory), max_bytes(max_bytes)
+{
+    load_index();
+}
+
+int64_t NFX_HttpCache::now()
+{
+    return std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+int64_t NFX_HttpCache::parse_http_date(const std::string& date)
+{
+    // IMF-fixdate, e.g. "Sun, 06 Nov 1994 08:49:37 GMT"
+    static const char* months[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+        "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+
+    int day, year, hour, minute, second;
+    char month_name[4] = { 0 };
+    if (sscanf(date.c_str(), "%*3s, %d %3s %d %d:%d:%d", &day, month_name, &year, &hour, &minute, &second) != 6) {
+        return -1;
+    }
+
+    for (unsigned m = 0; m < 12; m++) {
+        if (strcmp(month_name, months[m]) == 0) {
+            return days_from_civil(year, m + 1, day) * 86400 + hour * 3600 + minute * 60 + second;
+        }
+    }
+    return -1;
+}
+
+std::string NFX_HttpCache::hash_name(const std::string& url)
+{
+    // FNV-1a, only used to derive file names
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char c : url) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+
+    char name[17];
+    snprintf(name, sizeof(name), "%016llx", (unsigned long long)hash);
+    return name;
+}
+
+std::string NFX_HttpCache::path_for(const std::string& file) const
+{
+    return (fs::path(directory) / file).string();
+}
+
+bool NFX_HttpCache::compute_freshness(const httplib::Response& res, int64_t now, int64_t& fresh_until, bool& no_cache)
+{
+    std::string cache_control = to_lower(res.get_header_value("Cache-Control"));
+
+    if (find_directive(cache_control, "no-store")) return false;
+    if (res.get_header_value("Vary") == "*") return false;
+
+    no_cache = find_directive(cache_control, "no-cache");
+
+    // Ages are relative to the server's clock, applied to ours
+    int64_t date = parse_http_date(res.get_header_value("Date"));
+    if (date < 0) date = now;
+
+    std::string max_age;
+    if (find_directive(cache_control, "max-age", &max_age)) {
+        fresh_until = now + atoll(max_age.c_str());
+    }
+    else if (res.has_header("Expires")) {
+        // Invalid dates such as "0" mean already expired
+        int64_t expires = parse_http_date(res.get_header_value("Expires"));
+        fresh_until = expires < 0 ? 0 : now + (expires - date);
+    }
+    else if (res.has_header("Last-Modified")) {
+        // Heuristic freshness: 10% of the document's age, at most a day
+        int64_t last_modified = parse_http_date(res.get_header_value("Last-Modified"));
+        fresh_until = now;
+        if (last_modified > 0 && date > last_modified) {
+            fresh_until += std::min<int64_t>((date - last_modified) / 10, 86400);
+        }
+    }
+    else {
+        fresh_until = now;
+    }
+
+    bool has_validators = res.has_header("ETag") || res.has_header("Last-Modified");
+    return (!no_cache && fresh_until > now) || has_validators;
+}
+
+bool NFX_HttpCache::is_storable(const httplib::Response& res)
+{
+    if (res.status != 200) return false;
+
+    int64_t fresh_until;
+    bool no_cache;
+    return compute_freshness(res, now(), fresh_until, no_cache);
+}
+
+void NFX_HttpCache::load_index()
+{
+    std::error_code ec;
+    fs::create_directories(directory, ec);
+
+    std::map<std::string, bool> referenced_bodies;
+
+    for (const auto& file : fs::directory_iterator(directory, ec)) {
+        if (file.path().extension() != ".meta") continue;
+
+        std::ifstream in(file.path());
+        std::string line;
+        if (!std::getline(in, line) || line != "NFXCACHE 1") continue;
+
+        auto entry = std::make_shared<Entry>();
+        while (std::getline(in, line)) {
+            size_t space = line.find(' ');
+            if (space == std::string::npos) continue;
+            std::string key = line.substr(0, space);
+            std::string value = line.substr(space + 1);
+
+            if (key == "url") entry->url = value;
+            else if (key == "status") entry->status = atoi(value.c_str());
+            else if (key == "fresh_until") entry->fresh_until = atoll(value.c_str());
+            else if (key == "no_cache") entry->no_cache = value == "1";
+            else if (key == "etag") entry->etag = value;
+            else if (key == "last_modified") entry->last_modified = value;
+            else if (key == "redirect") entry->redirect = value;
+            else if (key == "body") entry->body_file = value;
+            else if (key == "size") entry->size = strtoull(value.c_str(), nullptr, 10);
+            else if (key == "last_access") entry->last_access = atoll(value.c_str());
+            else if (key == "header") {
+                size_t colon = value.find(": ");
+                if (colon != std::string::npos) {
+                    entry->headers.emplace(value.substr(0, colon), value.substr(colon + 2));
+                }
+            }
+        }
+
+        bool valid = !entry->url.empty() && hash_name(entry->url) + ".meta" == file.path().filename().string();
+        if (valid && entry->redirect.empty()) {
+            valid = !entry->body_file.empty() && fs::file_size(path_for(entry->body_file), ec) == entry->size && !ec;
+        }
+
+        if (!valid) {
+            fs::remove(file.path(), ec);
+            continue;
+        }
+
+        if (!entry->body_file.empty()) {
+            referenced_bodies[entry->body_file] = true;
+        }
+        total_bytes += entry->size;
+        entries[entry->url] = entry;
+    }
+
+    // Bodies whose metadata was never written or has been replaced
+    for (const auto& file : fs::directory_iterator(directory, ec)) {
+        std::string name = file.path().filename().string();
+        if (file.path().extension() == ".meta") continue;
+        if (!referenced_bodies.count(name)) {
+            fs::remove(file.path(), ec);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    evict();
+}
+
+bool NFX_HttpCache::write_meta(const Entry& entry)
+{
+    std::string meta_path = path_for(hash_name(entry.url) + ".meta");
+    std::string tmp_path = meta_path + ".tmp";
+
+    {
+        std::ofstream out(tmp_path, std::ios::trunc);
+        if (!out) return false;
+
+        out << "NFXCACHE 1\n";
+        out << "url " << entry.url << "\n";
+        out << "status " << entry.status << "\n";
+        out << "fresh_until " << entry.fresh_until << "\n";
+        out << "no_cache " << (entry.no_cache ? 1 : 0) << "\n";
+        if (!entry.etag.empty()) out << "etag " << entry.etag << "\n";
+        if (!entry.last_modified.empty()) out << "last_modified " << entry.last_modified << "\n";
+        if (!entry.redirect.empty()) out << "redirect " << entry.redirect << "\n";
+        if (!entry.body_file.empty()) out << "body " << entry.body_file << "\n";
+        out << "size " << entry.size << "\n";
+        out << "last_access " << entry.last_access << "\n";
+        for (const auto& header : entry.headers) {
+            out << "header " << header.first << ": " << header.second << "\n";
+        }
+
+        if (!out) return false;
+    }
+
+    std::error_code ec;
+    fs::rename(tmp_path, meta_path, ec);
+    return !ec;
+}
+
+void NFX_HttpCache::remove_files(const Entry& entry)
+{
+    std::error_code ec;
+    fs::remove(path_for(hash_name(entry.url) + ".meta"), ec);
+    if (!entry.body_file.empty()) {
+        // May fail while a reader still has it mapped; load_index() cleans up later
+        fs::remove(path_for(entry.body_file), ec);
+    }
+}
+
+void NFX_HttpCache::evict()
+{
+    while (total_bytes > max_bytes && !entries.empty()) {
+        auto oldest = entries.begin();
+        for (auto it = entries.begin(); it != entries.end(); ++it) {
+            if (it->second->last_access < oldest->second->last_access) {
+                oldest = it;
+            }
+        }
+
+        remove_files(*oldest->second);
+        total_bytes -= oldest->second->size;
+        entries.erase(oldest);
+        stats.evicted++;
+    }
+    stats.bytes = total_bytes;
+}
+
+std::shared_ptr<const NFX_HttpCache::Entry> NFX_HttpCache::lookup(const std::string& url)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto it = entries.find(url);
+    if (it == entries.end() || !it->second->redirect.empty()) {
+        stats.misses++;
+        return nullptr;
+    }
+
+    it->second->last_access = now();
+    if (it->second->is_fresh(it->second->last_access)) {
+        stats.hits++;
+    }
+    return it->second;
+}
+
+std::string NFX_HttpCache::lookup_redirect(const std::string& url)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto it = entries.find(url);
+    if (it == entries.end() || it->second->redirect.empty() || !it->second->is_fresh(now())) {
+        return "";
+    }
+
+    it->second->last_access = now();
+    stats.hits++;
+    return it->second->redirect;
+}
+
+std::unique_ptr<httplib::detail::mmap> NFX_HttpCache::open_body(const Entry& entry)
+{
+    auto body = std::make_unique<httplib::detail::mmap>(path_for(entry.body_file).c_str());
+    if (!body->is_open() || body->size() != entry.size) {
+        return nullptr;
+    }
+    return body;
+}
+
+bool NFX_HttpCache::BodyWriter::append(const char* data, size_t length)
+{
+    out.write(data, (std::streamsize)length);
+    entry->size += length;
+    return (bool)out;
+}
+
+NFX_HttpCache::BodyWriter::~BodyWriter()
+{
+    if (committed) return;
+
+    out.close();
+    std::error_code ec;
+    fs::remove(path, ec);
+}
+
+void NFX_HttpCache::store(const std::string& url, const httplib::Response& res, const std::string& body)
+{
+    std::unique_ptr<BodyWriter> writer = begin_store(url, res);
+    if (!writer || !writer->append(body.data(), body.size())) return;
+    commit(std::move(writer));
+}
+
+std::unique_ptr<NFX_HttpCache::BodyWriter> NFX_HttpCache::begin_store(const std::string& url, const httplib::Response& res)
+{
+    auto entry = std::make_shared<Entry>();
+    entry->url = url;
+    entry->status = res.status;
+    entry->last_access = now();
+    if (!compute_freshness(res, entry->last_access, entry->fresh_until, entry->no_cache)) return nullptr;
+
+    entry->etag = res.get_header_value("ETag");
+    entry->last_modified = res.get_header_value("Last-Modified");
+
+    // Hop-by-hop, length and encoding headers describe the original transfer;
+    // the stored body is already decompressed
+    for (const auto& header : res.headers) {
+        std::string name = to_lower(header.first);
+        if (name == "connection" || name == "keep-alive" || name == "transfer-encoding" ||
+            name == "content-length" || name == "content-encoding" || name == "set-cookie") continue;
+        entry->headers.emplace(header.first, header.second);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        entry->body_file = hash_name(url) + "-" + std::to_string(entry->last_access) + "-" +
+            std::to_string(++body_counter) + ".body";
+    }
+
+    // The body is written outside the lock; it is only published once complete
+    auto writer = std::make_unique<BodyWriter>();
+    writer->entry = entry;
+    writer->path = path_for(entry->body_file);
+    writer->out.open(writer->path, std::ios::binary | std::ios::trunc);
+    if (!writer->out) return nullptr;
+    return writer;
+}
+
+void NFX_HttpCache::commit(std::unique_ptr<BodyWriter> writer)
+{
+    writer->out.close();
+    if (!writer->out) return;
+
+    std::shared_ptr<Entry> entry = writer->entry;
+    const std::string& url = entry->url;
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (!write_meta(*entry)) return;
+    writer->committed = true;
+
+    auto it = entries.find(url);
+    if (it != entries.end()) {
+        // The new meta file already replaced the old one, only the old body goes
+        std::error_code ec;
+        if (!it->second->body_file.empty()) {
+            fs::remove(path_for(it->second->body_file), ec);
+        }
+        total_bytes -= it->second->size;
+    }
+
+    entries[url] = entry;
+    total_bytes += entry->size;
+    stats.stored++;
+    evict();
+}
+
+void NFX_HttpCache::store_redirect(const std::string& url, const httplib::Response& res, const std::string& location)
+{
+    auto entry = std::make_shared<Entry>();
+    entry->url = url;
+    entry->status = res.status;
+    entry->redirect = location;
+    entry->last_access = now();
+
+    std::string cache_control = to_lower(res.get_header_value("Cache-Control"));
+    if (find_directive(cache_control, "no-store")) return;
+
+    // Permanent redirects are cacheable by default; an explicit lifetime still wins
+    if (res.has_header("Cache-Control") || res.has_header("Expires")) {
+        compute_freshness(res, entry->last_access, entry->fresh_until, entry->no_cache);
+    }
+    else {
+        entry->fresh_until = entry->last_access + 365LL * 86400;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (!write_meta(*entry)) return;
+
+    auto it = entries.find(url);
+    if (it != entries.end()) {
+        std::error_code ec;
+        if (!it->second->body_file.empty()) {
+            fs::remove(path_for(it->second->body_file), ec);
+        }
+        total_bytes -= it->second->size;
+    }
+    entries[url] = entry;
+}
+
+void NFX_HttpCache::revalidated(const std::string& url, const httplib::Response& not_modified)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto it = entries.find(url);
+    if (it == entries.end()) return;
+
+    // Readers may hold the old entry, so update a copy
+    auto entry = std::make_shared<Entry>(*it->second);
+
+    // Headers sent with the 304 replace the stored ones
+    for (const auto& header : not_modified.headers) {
+        std::string name = to_lower(header.first);
+        if (name == "connection" || name == "keep-alive" || name == "transfer-encoding" ||
+            name == "content-length") continue;
+        entry->headers.erase(header.first);
+    }
+    for (const auto& header : not_modified.headers) {
+        std::string name = to_lower(header.first);
+        if (name == "connection" || name == "keep-alive" || name == "transfer-encoding" ||
+            name == "content-length") continue;
+        entry->headers.emplace(header.first, header.second);
+    }
+
+    httplib::Response merged;
+    merged.status = entry->status;
+    merged.headers = entry->headers;
+
+    entry->last_access = now();
+    compute_freshness(merged, entry->last_access, entry->fresh_until, entry->no_cache);
+    entry->etag = merged.get_header_value("ETag");
+    entry->last_modified = merged.get_header_value("Last-Modified");
+
+    write_meta(*entry);
+    it->second = entry;
+    stats.revalidated++;
+}
+
+void NFX_HttpCache::set_budget(uint64_t bytes)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    max_bytes = bytes;
+    evict();
+}
+
+NFX_HttpCache::Stats NFX_HttpCache::get_stats()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
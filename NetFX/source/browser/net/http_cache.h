@@ -0,0 +1,119 @@
+#pragma once
+
+#include <httplib.hpp>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// On-disk HTTP cache shared by every fetch. Honors Cache-Control, Expires,
+// ETag and Last-Modified, remembers permanent redirects and keeps the
+// stored bodies under a byte budget with least-recently-used eviction.
+//
+// Each entry is a small text .meta file plus a .body file that is memory
+// mapped when served.
+class NFX_HttpCache
+{
+public:
+    struct Entry {
+        std::string url;
+        int status = 200;
+        httplib::Headers headers;
+        std::string etag;
+        std::string last_modified;
+        std::string redirect;       // Target of a remembered 301/308
+        int64_t fresh_until = 0;    // Unix time after which the entry must be revalidated
+        bool no_cache = false;      // Cache-Control: no-cache, always revalidate
+        std::string body_file;
+        uint64_t size = 0;
+        int64_t last_access = 0;
+
+        bool is_fresh(int64_t now) const {
+            return !no_cache && now < fresh_until;
+        }
+
+        bool has_validators() const {
+            return !etag.empty() || !last_modified.empty();
+        }
+    };
+
+    // Body of one response being written as it arrives. The entry is only
+    // published by commit(); a writer dropped before that deletes its file.
+    class BodyWriter
+    {
+        friend class NFX_HttpCache;
+
+        std::shared_ptr<Entry> entry;
+        std::string path;
+        std::ofstream out;
+        bool committed = false;
+
+    public:
+        // False once a write failed; the writer should then be dropped
+        bool append(const char* data, size_t length);
+
+        ~BodyWriter();
+    };
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t revalidated = 0;
+        uint64_t misses = 0;
+        uint64_t stored = 0;
+        uint64_t evicted = 0;
+        uint64_t bytes = 0;
+    };
+
+private:
+    std::string directory;
+    uint64_t max_bytes;
+    uint64_t total_bytes = 0;
+    uint64_t body_counter = 0;
+    std::map<std::string, std::shared_ptr<Entry>> entries;
+    Stats stats;
+    std::mutex mutex;
+
+    void load_index();
+    bool write_meta(const Entry& entry);
+    void remove_files(const Entry& entry);
+    void evict();
+    std::string path_for(const std::string& file) const;
+
+    static std::string hash_name(const std::string& url);
+    static bool compute_freshness(const httplib::Response& res, int64_t now, int64_t& fresh_until, bool& no_cache);
+
+public:
+    NFX_HttpCache(const std::string& directory, uint64_t max_bytes);
+
+    // Fresh or stale entry for a URL, nullptr on a miss
+    std::shared_ptr<const Entry> lookup(const std::string& url);
+
+    // Target of a remembered permanent redirect, empty if there is none
+    std::string lookup_redirect(const std::string& url);
+
+    // Maps the stored body; nullptr if the file is gone
+    std::unique_ptr<httplib::detail::mmap> open_body(const Entry& entry);
+
+    // Whether a response may be written to the cache at all
+    static bool is_storable(const httplib::Response& res);
+
+    void store(const std::string& url, const httplib::Response& res, const std::string& body);
+
+    // Incremental form of store() for streamed bodies; nullptr if the
+    // response cannot be cached or the body file cannot be created
+    std::unique_ptr<BodyWriter> begin_store(const std::string& url, const httplib::Response& res);
+    void commit(std::unique_ptr<BodyWriter> writer);
+
+    void store_redirect(const std::string& url, const httplib::Response& res, const std::string& location);
+
+    // A 304 arrived for a stale entry; refresh its lifetime and validators
+    void revalidated(const std::string& url, const httplib::Response& not_modified);
+
+    void set_budget(uint64_t bytes);
+    Stats get_stats();
+
+    static int64_t now();
+    static int64_t parse_http_date(const std::string& date);
+};
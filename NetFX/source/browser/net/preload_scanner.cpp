@@ -0,0 +1,231 @@
+#include "preload_scanner.h"
+#include <cctype>
+#include <algorithm>
+#include <map>
+
+namespace
+{
+    bool is_space(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f';
+    }
+
+    std::string to_lower(std::string str)
+    {
+        for (char& c : str) {
+            c = (char)std::tolower((unsigned char)c);
+        }
+        return str;
+    }
+
+    // Attribute values may carry &amp; where the parser will see &
+    std::string decode_amp(std::string value)
+    {
+        size_t pos = 0;
+        while ((pos = value.find("&amp;", pos)) != std::string::npos) {
+            value.replace(pos, 5, "&");
+            pos++;
+        }
+        return value;
+    }
+
+    size_t find_case_insensitive(const std::string& haystack, const std::string& needle, size_t from)
+    {
+        if (needle.empty() || haystack.size() < needle.size()) return std::string::npos;
+
+        for (size_t i = from; i + needle.size() <= haystack.size(); i++) {
+            size_t k = 0;
+            while (k < needle.size() &&
+                std::tolower((unsigned char)haystack[i + k]) == needle[k]) {
+                k++;
+            }
+            if (k == needle.size()) return i;
+        }
+        return std::string::npos;
+    }
+}
+
+NFX_PreloadScanner::NFX_PreloadScanner(std::function<void(const NFX_PreloadResource&)> on_resource)
+    : on_resource(std::move(on_resource))
+{
+}
+
+std::string NFX_PreloadScanner::first_srcset_candidate(const std::string& srcset)
+{
+    size_t start = 0;
+    while (start < srcset.size() && (is_space(srcset[start]) || srcset[start] == ',')) {
+        start++;
+    }
+
+    size_t end = start;
+    while (end < srcset.size() && !is_space(srcset[end])) {
+        end++;
+    }
+
+    // A candidate without descriptor may end in the separating comma
+    while (end > start && srcset[end - 1] == ',') {
+        end--;
+    }
+
+    return srcset.substr(start, end - start);
+}
+
+void NFX_PreloadScanner::feed(const char* data, size_t length)
+{
+    std::string buf;
+    buf.reserve(carry.size() + length);
+    buf.append(carry);
+    buf.append(data, length);
+    carry.clear();
+
+    size_t i = 0;
+    while (i < buf.size()) {
+        if (!raw_text_end.empty()) {
+            size_t end = find_case_insensitive(buf, raw_text_end, i);
+            if (end == std::string::npos) {
+                // Keep enough bytes to match a closing tag split across chunks
+                size_t keep = std::min(buf.size() - i, raw_text_end.size() - 1);
+                carry = buf.substr(buf.size() - keep);
+                return;
+            }
+            i = end + raw_text_end.size();
+            raw_text_end.clear();
+            continue;
+        }
+
+        size_t lt = buf.find('<', i);
+        if (lt == std::string::npos) return;
+
+        if (buf.size() - lt < 4) {
+            carry = buf.substr(lt);
+            return;
+        }
+
+        // "a < b" in text is not markup
+        char next = buf[lt + 1];
+        if (!std::isalpha((unsigned char)next) && next != '/' && next != '!' && next != '?') {
+            i = lt + 1;
+            continue;
+        }
+
+        if (buf.compare(lt, 4, "<!--") == 0) {
+            size_t end = buf.find("-->", lt + 4);
+            if (end == std::string::npos) {
+                // Only the tail is needed to find the end of the comment
+                carry = "<!--" + buf.substr(std::max(lt + 4, buf.size() - 2));
+                return;
+            }
+            i = end + 3;
+            continue;
+        }
+
+        // Find the end of the tag, skipping '>' inside quoted values
+        size_t j = lt + 1;
+        char quote = 0;
+        while (j < buf.size()) {
+            char c = buf[j];
+            if (quote) {
+                if (c == quote) quote = 0;
+            }
+            else if (c == '"' || c == '\'') {
+                quote = c;
+            }
+            else if (c == '>') {
+                break;
+            }
+            j++;
+        }
+
+        if (j >= buf.size()) {
+            if (buf.size() - lt <= MAX_CARRY) {
+                carry = buf.substr(lt);
+            }
+            return;
+        }
+
+        handle_tag(buf.data() + lt + 1, buf.data() + j);
+        i = j + 1;
+    }
+}
+
+void NFX_PreloadScanner::handle_tag(const char* begin, const char* end)
+{
+    const char* p = begin;
+    while (p < end && std::isalnum((unsigned char)*p)) {
+        p++;
+    }
+
+    // Closing tags, doctype and processing instructions have no name here
+    if (p == begin) return;
+
+    std::string name = to_lower(std::string(begin, p));
+
+    if (name == "script" || name == "style" || name == "textarea" || name == "title") {
+        raw_text_end = "</" + name;
+        return;
+    }
+
+    if (name != "img" && name != "link") return;
+
+    std::map<std::string, std::string> attributes;
+    while (p < end) {
+        while (p < end && (is_space(*p) || *p == '/')) {
+            p++;
+        }
+
+        const char* attr_begin = p;
+        while (p < end && !is_space(*p) && *p != '=' && *p != '/') {
+            p++;
+        }
+        if (p == attr_begin) break;
+        std::string attr_name = to_lower(std::string(attr_begin, p));
+
+        while (p < end && is_space(*p)) {
+            p++;
+        }
+
+        std::string value;
+        if (p < end && *p == '=') {
+            p++;
+            while (p < end && is_space(*p)) {
+                p++;
+            }
+
+            if (p < end && (*p == '"' || *p == '\'')) {
+                char quote = *p++;
+                const char* value_begin = p;
+                while (p < end && *p != quote) {
+                    p++;
+                }
+                value.assign(value_begin, p);
+                if (p < end) p++;
+            }
+            else {
+                const char* value_begin = p;
+                while (p < end && !is_space(*p)) {
+                    p++;
+                }
+                value.assign(value_begin, p);
+            }
+        }
+
+        // First occurrence wins, as in the tree builder
+        attributes.emplace(attr_name, decode_amp(value));
+    }
+
+    if (name == "img") {
+        std::string src = attributes["src"];
+        if (src.empty()) {
+            src = first_srcset_candidate(attributes["srcset"]);
+        }
+        if (!src.empty()) {
+            on_resource({ NFX_PreloadResource::IMAGE, src });
+        }
+    }
+    else if (name == "link") {
+        // el_link only loads rel="stylesheet" exactly, so match it the same way
+        if (attributes["rel"] == "stylesheet" && !attributes["href"].empty()) {
+            on_resource({ NFX_PreloadResource::STYLESHEET, attributes["href"] });
+        }
+    }
+}
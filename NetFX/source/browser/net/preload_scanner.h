@@ -0,0 +1,42 @@
+#pragma once
+
+#include <functional>
+#include <string>
+
+struct NFX_PreloadResource
+{
+    enum Type {
+        IMAGE,
+        STYLESHEET
+    };
+
+    Type type;
+    std::string url;    // As written in the markup, not yet resolved
+};
+
+// Byte-level scanner that runs over HTML while it streams in and reports
+// subresources (<img src/srcset>, <link rel=stylesheet>) long before the
+// tree builder reaches them. It only looks at tags, never builds a tree.
+class NFX_PreloadScanner
+{
+private:
+    static const size_t MAX_CARRY = 64 * 1024;
+
+    std::function<void(const NFX_PreloadResource&)> on_resource;
+
+    // Unfinished markup left over from the previous chunk
+    std::string carry;
+
+    // Set to "</script", "</style", ... while inside raw text content
+    std::string raw_text_end;
+
+    void handle_tag(const char* begin, const char* end);
+
+public:
+    NFX_PreloadScanner(std::function<void(const NFX_PreloadResource&)> on_resource);
+
+    void feed(const char* data, size_t length);
+
+    // First URL of a srcset attribute, the one a 1x display would pick
+    static std::string first_srcset_candidate(const std::string& srcset);
+};
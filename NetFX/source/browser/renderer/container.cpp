@@ -1,34 +1,67 @@
 #include "container.h"
 #include <iostream>
 #include <algorithm>
+#include <set>
 #include <thread>
 #include <future>
 #include <httplib.hpp>
 #include <SDL_image.h>
 #include "../browser.h"
 
+thread_local uint64_t NFX_Container::current_page = 0;
+
 NFX_Container::NFX_Container(SDL_Renderer* renderer)
-    : renderer(renderer), default_font_size(16), default_font_name("Roboto-Regular.ttf")
+    : renderer(renderer), default_font_size(16), default_font_name("Roboto"), font_manager("Roboto-Regular.ttf"), glyph_atlas(renderer),
+    text_cache(renderer, glyph_atlas, TEXT_CACHE_BUDGET),
+    image_decoder(SDL_PIXELFORMAT_ARGB8888, false)
 {
+    // Decode into whichever 32-bit layout the renderer takes without conversion
+    Uint32 image_format = SDL_PIXELFORMAT_ARGB8888;
+    SDL_RendererInfo info;
+    if (SDL_GetRendererInfo(renderer, &info) == 0) {
+        for (Uint32 i = 0; i < info.num_texture_formats; i++) {
+            if (info.texture_formats[i] == SDL_PIXELFORMAT_ARGB8888 || info.texture_formats[i] == SDL_PIXELFORMAT_ABGR8888) {
+                image_format = info.texture_formats[i];
+                break;
+            }
+        }
+    }
+
+    // Premultiplied pixels need a matching blend mode; not every backend has custom ones
+    SDL_BlendMode premultiplied = SDL_ComposeCustomBlendMode(
+        SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD,
+        SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD);
+    SDL_Texture* probe = SDL_CreateTexture(renderer, image_format, SDL_TEXTUREACCESS_STATIC, 1, 1);
+    bool premultiply = probe && SDL_SetTextureBlendMode(probe, premultiplied) == 0;
+    if (probe) SDL_DestroyTexture(probe);
+
+    image_blend_mode = premultiply ? premultiplied : SDL_BLENDMODE_BLEND;
+    image_decoder = NFX_ImageDecoder(image_format, premultiply);
+
+    // Closed fonts must not leave glyphs or widths behind, the pointer can come back
+    font_manager.on_close = [this](TTF_Font* font) {
+        glyph_atlas.release_font(font);
+        text_cache.release_font(font);
+        text_measurer.release_font(font);
+    };
+
+    // Layout workers measure with the same instances the atlas rasterizes from
+    glyph_atlas.lock_font = [this](TTF_Font* font) { return font_manager.lock_font(font); };
+    text_measurer.lock_font = [this](TTF_Font* font) { return font_manager.lock_font(font); };
+    text_measurer.has_layout_tables = [this](TTF_Font* font) { return font_manager.has_layout_tables(font); };
+
     // Load default fonts (similar to your existing renderer)
-    fonts["default"] = TTF_OpenFont("Roboto-Regular.ttf", 16);
-    fonts["h1"] = TTF_OpenFont("Roboto-Regular.ttf", 32);
-    fonts["h2"] = TTF_OpenFont("Roboto-Regular.ttf", 24);
-    fonts["h3"] = TTF_OpenFont("Roboto-Regular.ttf", 20);
+    fonts["default"] = font_manager.acquire(default_font_name.c_str(), 16, 400, false);
+    fonts["h1"] = font_manager.acquire(default_font_name.c_str(), 32, 400, false);
+    fonts["h2"] = font_manager.acquire(default_font_name.c_str(), 24, 400, false);
+    fonts["h3"] = font_manager.acquire(default_font_name.c_str(), 20, 400, false);
 }
 
 NFX_Container::~NFX_Container()
 {
     for (auto& font_pair : fonts) {
         if (font_pair.second) {
-            TTF_CloseFont(font_pair.second);
-        }
-    }
-
-    // Clean up loaded images
-    for (auto& img_pair : loaded_images) {
-        if (img_pair.second.texture) {
-            SDL_DestroyTexture(img_pair.second.texture);
+            font_manager.release(font_pair.second);
         }
     }
 }
@@ -78,100 +111,103 @@ std::string NFX_Container::resolve_url(const std::string& src, const std::string
     return resolved;
 }
 
-void NFX_Container::load_image_async(const std::string& url, const std::string& src)
+void NFX_Container::decode_image(const std::string& url, const std::string& bytes)
 {
-    std::thread([this, url, src]() {
-        try {
-            // Parse URL
-            std::string remaining = url;
-            std::string protocol, hostname, path;
-            int port = 80;
-
-            // Extract protocol
-            size_t proto_pos = remaining.find("://");
-            if (proto_pos != std::string::npos) {
-                protocol = remaining.substr(0, proto_pos);
-                remaining = remaining.substr(proto_pos + 3);
-
-                if (protocol == "https") {
-                    port = 443;
-                }
-            }
-            else {
-                protocol = "http";
-            }
+    PendingUpload upload;
+    upload.url = url;
 
-            // Extract hostname and path
-            size_t path_pos = remaining.find('/');
-            if (path_pos != std::string::npos) {
-                hostname = remaining.substr(0, path_pos);
-                path = remaining.substr(path_pos);
-            }
-            else {
-                hostname = remaining;
-                path = "/";
-            }
+    if (!image_decoder.decode(bytes, upload.image)) {
+        std::cout << "Failed to decode image: " << url << std::endl;
+        resource_cache->set_failed(url);
+        return;
+    }
 
-            // Check for port in hostname
-            size_t port_pos = hostname.find(':');
-            if (port_pos != std::string::npos) {
-                std::string port_str = hostname.substr(port_pos + 1);
-                hostname = hostname.substr(0, port_pos);
-                try {
-                    port = std::stoi(port_str);
-                }
-                catch (...) {
-                    // Keep default port
-                }
-            }
+    {
+        std::lock_guard<std::mutex> lock(uploads_mutex);
+        pending_uploads.push_back(std::move(upload));
+    }
 
-            // Download image
-            httplib::Result res;
-            httplib::Headers headers = {
-                {"User-Agent", "NetFX Browser/1.0"},
-                {"Accept", "image/*,*/*;q=0.8"},
-                {"Connection", "close"}
-            };
-
-            if (protocol == "https") {
-                httplib::SSLClient ssl_cli(hostname, port);
-                ssl_cli.enable_server_certificate_verification(false);
-                ssl_cli.set_connection_timeout(10, 0);
-                ssl_cli.set_read_timeout(15, 0);
-                ssl_cli.set_write_timeout(10, 0);
-                res = ssl_cli.Get(path, headers);
-            }
-            else {
-                httplib::Client http_cli(hostname, port);
-                http_cli.set_connection_timeout(10, 0);
-                http_cli.set_read_timeout(15, 0);
-                http_cli.set_write_timeout(10, 0);
-                res = http_cli.Get(path, headers);
-            }
+    // The render thread may be asleep waiting for events
+    if (browser) {
+        ((NFX_Browser*)browser)->wake();
+    }
+}
+
+bool NFX_Container::has_pending_uploads()
+{
+    std::lock_guard<std::mutex> lock(uploads_mutex);
+    return !pending_uploads.empty();
+}
+
+void NFX_Container::upload_images(litehtml::string_vector& loaded_srcs)
+{
+    Uint64 start = SDL_GetPerformanceCounter();
+    Uint64 limit = SDL_GetPerformanceFrequency() * UPLOAD_MS_PER_FRAME / 1000;
+    size_t uploaded = 0;
+    std::set<std::string> loaded_urls;
+
+    while (true) {
+        PendingUpload upload;
+        {
+            std::lock_guard<std::mutex> lock(uploads_mutex);
+            if (pending_uploads.empty()) break;
+
+            // Whatever does not fit waits for the next frame
+            if (uploaded > 0 && (uploaded >= UPLOAD_BYTES_PER_FRAME || SDL_GetPerformanceCounter() - start >= limit)) break;
+
+            upload = std::move(pending_uploads.front());
+            pending_uploads.pop_front();
+        }
+
+        const NFX_DecodedImage& image = upload.image;
+        SDL_Texture* texture = SDL_CreateTexture(renderer, image.format, SDL_TEXTUREACCESS_STATIC, image.width, image.height);
+        if (!texture) {
+            std::cout << "Failed to create texture for " << upload.url << ": " << SDL_GetError() << std::endl;
+            resource_cache->set_failed(upload.url);
+            continue;
+        }
+
+        SDL_SetTextureBlendMode(texture, image_blend_mode);
+        SDL_UpdateTexture(texture, nullptr, image.pixels.data(), image.width * 4);
+        resource_cache->set_texture(upload.url, texture, image.width, image.height);
+        uploaded += image.pixels.size() * 4;
+        loaded_urls.insert(upload.url);
+
+        std::cout << "Image loaded: " << upload.url << " (" << image.width << "x" << image.height << ")" << std::endl;
+    }
+
+    if (loaded_urls.empty()) return;
+
+    // The same URL may be referenced by several differently written srcs
+    std::lock_guard<std::mutex> lock(pages_mutex);
+    for (const auto& entry : pages[current_page].image_urls) {
+        if (loaded_urls.count(entry.second)) {
+            loaded_srcs.push_back(entry.first);
+        }
+    }
+}
+
+void NFX_Container::end_frame()
+{
+    text_cache.trim();
+}
 
+void NFX_Container::load_image_async(const std::string& url, NFX_FetchPriority priority)
+{
+    NFX_FetchRequest request((NFX_Url(url)));
+    request.priority = priority;
+    request.headers = {
+        {"User-Agent", "NetFX Browser/1.0"},
+        {"Accept", "image/*,*/*;q=0.8"}
+    };
+
+    request.on_complete = [this, url](httplib::Result& res) {
+        try {
             if (res && res->status == 200) {
-                // Create SDL texture from image data
-                SDL_RWops* rw = SDL_RWFromConstMem(res->body.data(), res->body.size());
-                if (rw) {
-                    SDL_Surface* surface = IMG_Load_RW(rw, 1); // This frees the RWops
-                    if (surface) {
-                        SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
-                        if (texture) {
-                            // Store the loaded image
-                            {
-                                std::lock_guard<std::mutex> lock(images_mutex);
-                                LoadedImage& img = loaded_images[src];
-                                img.texture = texture;
-                                img.width = surface->w;
-                                img.height = surface->h;
-                                img.loaded = true;
-
-                                std::cout << "Image loaded: " << src << " (" << img.width << "x" << img.height << ")" << std::endl;
-                            }
-                        }
-                        SDL_FreeSurface(surface);
-                    }
-                }
+                // Keep the encoded bytes so an evicted texture can be rebuilt without the network
+                auto bytes = std::make_shared<const std::string>(std::move(res->body));
+                resource_cache->set_encoded(url, bytes);
+                decode_image(url, *bytes);
             }
             else {
                 std::cout << "Failed to load image: " << url;
@@ -179,37 +215,119 @@ void NFX_Container::load_image_async(const std::string& url, const std::string&
                     std::cout << " (HTTP " << res->status << ")";
                 }
                 std::cout << std::endl;
+                resource_cache->set_failed(url);
             }
         }
         catch (const std::exception& e) {
             std::cout << "Exception loading image " << url << ": " << e.what() << std::endl;
+            resource_cache->set_failed(url);
         }
-        }).detach();
+    };
+
+    request.on_cancel = [this, url]() {
+        // Forget the placeholder so the image is fetched again if it is needed later
+        resource_cache->forget(url);
+    };
+
+    fetch_scheduler->submit(std::move(request));
+}
+
+void NFX_Container::decode_image_async(const std::string& url, std::shared_ptr<const std::string> bytes, NFX_FetchPriority priority)
+{
+    // Restyles ask for evicted images on the UI thread, so the decode runs on
+    // a worker; the entry stays LOADING until the upload or the failure lands
+    NFX_FetchRequest request((NFX_Url(url)));
+    request.priority = priority;
+
+    request.task = [this, url, bytes]() {
+        try {
+            decode_image(url, *bytes);
+        }
+        catch (const std::exception& e) {
+            std::cout << "Exception decoding image " << url << ": " << e.what() << std::endl;
+            resource_cache->set_failed(url);
+        }
+    };
+
+    request.on_cancel = [this, url]() {
+        resource_cache->forget(url);
+    };
+
+    fetch_scheduler->submit(std::move(request));
 }
 
 void NFX_Container::load_image(const char* src, const char* baseurl, bool redraw_on_ready)
 {
     if (!src) return;
 
-    std::string src_str = src;
-    std::string base_str = baseurl ? baseurl : current_base_url;
+    // Nothing is laid out yet, so nothing is known to be visible
+    request_image(src, baseurl ? baseurl : page_base_url(), NFX_FETCH_OFFSCREEN_IMAGE);
+}
+
+void NFX_Container::preload_image(const std::string& src, const std::string& baseurl, NFX_FetchPriority priority)
+{
+    request_image(src, baseurl, priority);
+}
+
+void NFX_Container::request_image(const std::string& src_str, const std::string& base_str, NFX_FetchPriority priority)
+{
+    if (!resource_cache || !fetch_scheduler) return;
+
+    std::string full_url = resolve_url(src_str, base_str);
+    if (full_url.empty()) return;
 
-    // Check if already loaded or loading
     {
-        std::lock_guard<std::mutex> lock(images_mutex);
-        auto it = loaded_images.find(src_str);
-        if (it != loaded_images.end()) {
-            return; // Already loaded or loading
-        }
+        std::lock_guard<std::mutex> lock(pages_mutex);
+        pages[current_page].image_urls[src_str] = full_url;
+    }
 
-        // Mark as loading
-        loaded_images[src_str] = LoadedImage();
+    // The cache decides whether this is a hit, a re-decode or a new download
+    switch (resource_cache->request(full_url, current_page)) {
+    case NFX_ResourceCache::FETCH:
+        std::cout << "Loading image: " << src_str << " -> " << full_url << std::endl;
+        load_image_async(full_url, priority);
+        break;
+    case NFX_ResourceCache::DECODE:
+        if (auto bytes = resource_cache->get_encoded(full_url)) {
+            decode_image_async(full_url, bytes, priority);
+        }
+        else {
+            resource_cache->forget(full_url);
+        }
+        break;
+    default:
+        break;
     }
+}
 
-    std::string full_url = resolve_url(src_str, base_str);
-    std::cout << "Loading image: " << src_str << " -> " << full_url << std::endl;
+bool NFX_Container::find_image(const char* src, NFX_ResourceCache::Image& image)
+{
+    if (!src || !resource_cache) return false;
+
+    std::string full_url = find_image_url(src);
+    if (full_url.empty()) return false;
+
+    return resource_cache->get_image(full_url, image);
+}
 
-    load_image_async(full_url, src_str);
+std::string NFX_Container::find_image_url(const char* src)
+{
+    std::lock_guard<std::mutex> lock(pages_mutex);
+    auto page = pages.find(current_page);
+    if (page == pages.end()) return "";
+    auto it = page->second.image_urls.find(src);
+    if (it == page->second.image_urls.end()) return "";
+    return it->second;
+}
+
+void NFX_Container::promote_image(const char* src)
+{
+    if (!src || !fetch_scheduler) return;
+
+    std::string full_url = find_image_url(src);
+    if (!full_url.empty()) {
+        fetch_scheduler->promote(full_url, NFX_FETCH_VISIBLE_IMAGE);
+    }
 }
 
 void NFX_Container::get_image_size(const char* src, const char* baseurl, litehtml::size& sz)
@@ -220,16 +338,13 @@ void NFX_Container::get_image_size(const char* src, const char* baseurl, litehtm
         return;
     }
 
-    std::string src_str = src;
-
-    std::lock_guard<std::mutex> lock(images_mutex);
-    auto it = loaded_images.find(src_str);
-    if (it != loaded_images.end() && it->second.loaded) {
-        sz.width = it->second.width;
-        sz.height = it->second.height;
+    NFX_ResourceCache::Image image;
+    if (find_image(src, image)) {
+        sz.width = image.width;
+        sz.height = image.height;
     }
     else {
-        // Return default size while loading
+        // Placeholder size while loading; the document is laid out again once it arrives
         sz.width = 100;
         sz.height = 100;
     }
@@ -240,15 +355,14 @@ void NFX_Container::draw_image(litehtml::uint_ptr hdc, const char* src, const ch
 {
     if (!src) return;
 
-    std::string src_str = src;
-
-    std::lock_guard<std::mutex> lock(images_mutex);
-    auto it = loaded_images.find(src_str);
-    if (it != loaded_images.end() && it->second.loaded && it->second.texture) {
+    NFX_ResourceCache::Image image;
+    if (find_image(src, image)) {
         SDL_Rect dst = { pos.x, pos.y, pos.width, pos.height };
-        SDL_RenderCopy(renderer, it->second.texture, nullptr, &dst);
+        SDL_RenderCopy(renderer, image.texture, nullptr, &dst);
     }
     else {
+        promote_image(src);
+
         // Draw placeholder rectangle
         SDL_SetRenderDrawColor(renderer, 000, 100, 200, 255);
         SDL_Rect placeholder = { pos.x, pos.y, pos.width, pos.height };
@@ -268,11 +382,12 @@ litehtml::uint_ptr NFX_Container::create_font(const char* faceName, int size, in
     litehtml::font_style italic, unsigned int decoration,
     litehtml::font_metrics* fm)
 {
-    // For now, use our default font with the requested size
-    TTF_Font* font = TTF_OpenFont("Roboto-Regular.ttf", size);
+    // Faces are matched by family, weight and style; instances are shared per size
+    TTF_Font* font = font_manager.acquire(faceName, size, weight, italic == litehtml::font_style_italic);
 
     if (font && fm) {
         // Fill font metrics
+        auto font_lock = font_manager.lock_font(font);
         fm->height = TTF_FontHeight(font);
         fm->ascent = TTF_FontAscent(font);
         fm->descent = TTF_FontDescent(font);
@@ -282,11 +397,15 @@ litehtml::uint_ptr NFX_Container::create_font(const char* faceName, int size, in
     return reinterpret_cast<litehtml::uint_ptr>(font);
 }
 
+std::unique_lock<std::mutex> NFX_Container::lock_font(TTF_Font* font)
+{
+    return font_manager.lock_font(font);
+}
+
 void NFX_Container::delete_font(litehtml::uint_ptr hFont)
 {
     if (hFont) {
-        TTF_Font* font = reinterpret_cast<TTF_Font*>(hFont);
-        TTF_CloseFont(font);
+        font_manager.release(reinterpret_cast<TTF_Font*>(hFont));
     }
 }
 
@@ -294,14 +413,13 @@ int NFX_Container::text_width(const char* text, litehtml::uint_ptr hFont)
 {
     if (!text || !hFont) return 0;
 
-    TTF_Font* font = reinterpret_cast<TTF_Font*>(hFont);
-    int width, height;
-
-    if (TTF_SizeText(font, text, &width, &height) == 0) {
-        return width;
-    }
+    // Measured as UTF-8 so widths match what the glyph atlas draws
+    return text_measurer.text_width(reinterpret_cast<TTF_Font*>(hFont), text);
+}
 
-    return 0;
+void NFX_Container::text_widths(const char* const* texts, int* widths, size_t count, litehtml::uint_ptr hFont)
+{
+    text_measurer.text_widths(reinterpret_cast<TTF_Font*>(hFont), texts, widths, count);
 }
 
 void NFX_Container::draw_text(litehtml::uint_ptr hdc, const char* text, litehtml::uint_ptr hFont,
@@ -318,17 +436,14 @@ void NFX_Container::draw_text(litehtml::uint_ptr hdc, const char* text, litehtml
         static_cast<Uint8>(color.alpha)
     };
 
-    SDL_Surface* surface = TTF_RenderText_Solid(font, text, sdl_color);
-    if (!surface) return;
-
-    SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
-    if (texture) {
-        SDL_Rect dst = { pos.x, pos.y, surface->w, surface->h };
-        SDL_RenderCopy(renderer, texture, NULL, &dst);
-        SDL_DestroyTexture(texture);
+    if (recording) {
+        SDL_Rect bounds = { pos.x, pos.y, pos.width, pos.height };
+        recording->add_text(font, text, sdl_color, bounds);
+        return;
     }
 
-    SDL_FreeSurface(surface);
+    // Runs seen in earlier frames are one texture copy, new ones come from the glyph atlas
+    text_cache.draw_text(font, text, sdl_color, pos.x, pos.y);
 }
 
 int NFX_Container::pt_to_px(int pt) const
@@ -351,9 +466,8 @@ void NFX_Container::draw_list_marker(litehtml::uint_ptr hdc, const litehtml::lis
 {
     // Basic implementation - just draw bullet point for now
     if (marker.marker_type == litehtml::list_style_type_disc) {
-        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
         SDL_Rect bullet = { marker.pos.x, marker.pos.y + 5, 4, 4 };
-        SDL_RenderFillRect(renderer, &bullet);
+        fill_rect(litehtml::web_color(0, 0, 0), bullet);
     }
 }
 
@@ -364,20 +478,87 @@ void NFX_Container::draw_background(litehtml::uint_ptr hdc, const std::vector<li
     // Draw the background color from the last background
     const auto& background = bg.back();
     if (background.color.alpha > 0) {
-        SDL_SetRenderDrawColor(renderer,
-            background.color.red,
-            background.color.green,
-            background.color.blue,
-            background.color.alpha);
-
         SDL_Rect rect = {
             background.clip_box.x,
             background.clip_box.y,
             background.clip_box.width,
             background.clip_box.height
         };
-        SDL_RenderFillRect(renderer, &rect);
+        fill_rect(background.color, rect);
+    }
+
+    // Image layers are listed top first, <img> elements arrive here as a single layer
+    for (auto it = bg.rbegin(); it != bg.rend(); ++it) {
+        if (!it->image.empty()) {
+            draw_background_image(*it);
+        }
+    }
+}
+
+void NFX_Container::draw_background_image(const litehtml::background_paint& layer)
+{
+    // The texture is looked up when replayed, so images arriving later still show
+    if (recording) {
+        recording->add_image(layer);
+        return;
+    }
+
+    NFX_ResourceCache::Image image;
+    if (!find_image(layer.image.c_str(), image)) {
+        promote_image(layer.image.c_str());
+        return;
     }
+
+    int width = layer.image_size.width > 0 ? layer.image_size.width : image.width;
+    int height = layer.image_size.height > 0 ? layer.image_size.height : image.height;
+    if (width <= 0 || height <= 0) return;
+
+    SDL_Rect clip = { layer.clip_box.x, layer.clip_box.y, layer.clip_box.width, layer.clip_box.height };
+
+    // The layer must stay inside the area being repainted, and a repeated
+    // layer only needs the tiles that land on the render target
+    SDL_Rect previous_clip;
+    bool had_clip = SDL_RenderIsClipEnabled(renderer);
+    SDL_RenderGetClipRect(renderer, &previous_clip);
+    if (had_clip && !SDL_IntersectRect(&clip, &previous_clip, &clip)) return;
+
+    SDL_Rect target;
+    SDL_RenderGetViewport(renderer, &target);
+    target.x = 0;
+    target.y = 0;
+    if (!SDL_IntersectRect(&clip, &target, &clip)) return;
+
+    // Tiles start at the positioned image and extend in the repeated directions
+    int x0 = layer.position_x;
+    int y0 = layer.position_y;
+    int x1 = x0 + width;
+    int y1 = y0 + height;
+
+    bool repeat_x = layer.repeat == litehtml::background_repeat_repeat || layer.repeat == litehtml::background_repeat_repeat_x;
+    bool repeat_y = layer.repeat == litehtml::background_repeat_repeat || layer.repeat == litehtml::background_repeat_repeat_y;
+
+    // Repeated tiles start at the last one beginning at or before the clip
+    if (repeat_x) {
+        if (x0 > clip.x) x0 -= (x0 - clip.x + width - 1) / width * width;
+        else x0 += (clip.x - x0) / width * width;
+        x1 = clip.x + clip.w;
+    }
+    if (repeat_y) {
+        if (y0 > clip.y) y0 -= (y0 - clip.y + height - 1) / height * height;
+        else y0 += (clip.y - y0) / height * height;
+        y1 = clip.y + clip.h;
+    }
+
+    SDL_RenderSetClipRect(renderer, &clip);
+
+    for (int y = y0; y < y1; y += height) {
+        for (int x = x0; x < x1; x += width) {
+            SDL_Rect dst = { x, y, width, height };
+            SDL_RenderCopy(renderer, image.texture, nullptr, &dst);
+        }
+    }
+
+    SDL_RenderSetClipRect(renderer, had_clip ? &previous_clip : nullptr);
 }
 
 void NFX_Container::draw_borders(litehtml::uint_ptr hdc, const litehtml::borders& borders,
@@ -385,46 +566,81 @@ void NFX_Container::draw_borders(litehtml::uint_ptr hdc, const litehtml::borders
 {
     // Simple border drawing - just draw rectangles for each border
     if (borders.top.width > 0) {
-        SDL_SetRenderDrawColor(renderer,
-            borders.top.color.red,
-            borders.top.color.green,
-            borders.top.color.blue,
-            borders.top.color.alpha);
         SDL_Rect top = { draw_pos.x, draw_pos.y, draw_pos.width, borders.top.width };
-        SDL_RenderFillRect(renderer, &top);
+        fill_rect(borders.top.color, top);
     }
 
     // Similar for other borders...
     if (borders.bottom.width > 0) {
-        SDL_SetRenderDrawColor(renderer,
-            borders.bottom.color.red,
-            borders.bottom.color.green,
-            borders.bottom.color.blue,
-            borders.bottom.color.alpha);
         SDL_Rect bottom = { draw_pos.x, draw_pos.y + draw_pos.height - borders.bottom.width,
                            draw_pos.width, borders.bottom.width };
-        SDL_RenderFillRect(renderer, &bottom);
+        fill_rect(borders.bottom.color, bottom);
     }
 
     if (borders.left.width > 0) {
-        SDL_SetRenderDrawColor(renderer,
-            borders.left.color.red,
-            borders.left.color.green,
-            borders.left.color.blue,
-            borders.left.color.alpha);
         SDL_Rect left = { draw_pos.x, draw_pos.y, borders.left.width, draw_pos.height };
-        SDL_RenderFillRect(renderer, &left);
+        fill_rect(borders.left.color, left);
     }
 
     if (borders.right.width > 0) {
-        SDL_SetRenderDrawColor(renderer,
-            borders.right.color.red,
-            borders.right.color.green,
-            borders.right.color.blue,
-            borders.right.color.alpha);
         SDL_Rect right = { draw_pos.x + draw_pos.width - borders.right.width, draw_pos.y,
                           borders.right.width, draw_pos.height };
-        SDL_RenderFillRect(renderer, &right);
+        fill_rect(borders.right.color, right);
+    }
+}
+
+void NFX_Container::fill_rect(const litehtml::web_color& color, const SDL_Rect& rect)
+{
+    // Transparent colors would otherwise paint opaque with the default blend mode
+    if (color.alpha == 0) return;
+
+    SDL_Color sdl_color = { color.red, color.green, color.blue, color.alpha };
+    if (recording) {
+        recording->add_rect(sdl_color, rect);
+        return;
+    }
+
+    SDL_SetRenderDrawColor(renderer, sdl_color.r, sdl_color.g, sdl_color.b, sdl_color.a);
+    SDL_RenderFillRect(renderer, &rect);
+}
+
+void NFX_Container::record(const std::shared_ptr<litehtml::document>& doc, NFX_DisplayList& list)
+{
+    list.clear();
+
+    // Nothing is culled while recording; the root background covers the page and the window
+    litehtml::position client;
+    get_client_rect(client);
+    litehtml::position clip(0, 0, std::max(doc->width(), client.width), std::max(doc->height(), client.height));
+
+    recording = &list;
+    try {
+        doc->draw(reinterpret_cast<litehtml::uint_ptr>(renderer), 0, 0, &clip);
+    }
+    catch (...) {
+        recording = nullptr;
+        throw;
+    }
+    recording = nullptr;
+}
+
+void NFX_Container::replay(const NFX_DisplayList& list, const SDL_Rect& viewport)
+{
+    list.query(viewport, visible_items);
+
+    for (const NFX_DisplayList::Item* item : visible_items) {
+        switch (item->type) {
+        case NFX_DisplayList::TEXT:
+            text_cache.draw_text(item->font, list.get_text(*item), item->color, item->bounds.x, item->bounds.y);
+            break;
+        case NFX_DisplayList::RECT:
+            SDL_SetRenderDrawColor(renderer, item->color.r, item->color.g, item->color.b, item->color.a);
+            SDL_RenderFillRect(renderer, &item->bounds);
+            break;
+        case NFX_DisplayList::IMAGE:
+            draw_background_image(list.get_layer(*item));
+            break;
+        }
     }
 }
 
@@ -442,10 +658,18 @@ void NFX_Container::set_base_url(const char* base_url)
 {
     // Store base URL for relative link resolution
     if (base_url) {
-        current_base_url = base_url;
+        std::lock_guard<std::mutex> lock(pages_mutex);
+        pages[current_page].base_url = base_url;
     }
 }
 
+std::string NFX_Container::page_base_url()
+{
+    std::lock_guard<std::mutex> lock(pages_mutex);
+    auto page = pages.find(current_page);
+    return page != pages.end() ? page->second.base_url : "";
+}
+
 void NFX_Container::link(const std::shared_ptr<litehtml::document>& doc, const litehtml::element::ptr& el)
 {
     // Handle link elements (like <link rel="stylesheet">)
@@ -494,9 +718,72 @@ void NFX_Container::transform_text(litehtml::string& text, litehtml::text_transf
     }
 }
 
+std::shared_future<std::string> NFX_Container::fetch_css(const std::string& full_url)
+{
+    std::lock_guard<std::mutex> lock(css_mutex);
+
+    // Either already loaded or still in flight from the preload scanner
+    auto it = imported_css.find(full_url);
+    if (it != imported_css.end()) {
+        return it->second;
+    }
+
+    std::cout << "Loading stylesheet: " << full_url << std::endl;
+
+    auto body = std::make_shared<std::promise<std::string>>();
+    std::shared_future<std::string> result = body->get_future().share();
+    imported_css[full_url] = result;
+
+    NFX_FetchRequest request((NFX_Url(full_url)));
+    request.priority = NFX_FETCH_STYLESHEET;
+    request.follow_location = true;
+    request.headers = {
+        {"User-Agent", "NetFX Browser/1.0"},
+        {"Accept", "text/css,*/*;q=0.1"}
+    };
+
+    request.on_complete = [body, full_url](httplib::Result& res) {
+        if (res && res->status == 200) {
+            body->set_value(res->body);
+            return;
+        }
+
+        std::cout << "Failed to load stylesheet: " << full_url;
+        if (res) {
+            std::cout << " (HTTP " << res->status << ")";
+        }
+        std::cout << std::endl;
+        body->set_value("");
+    };
+
+    request.on_cancel = [body]() {
+        body->set_value("");
+    };
+
+    fetch_scheduler->submit(std::move(request));
+    return result;
+}
+
 void NFX_Container::import_css(litehtml::string& text, const litehtml::string& url, litehtml::string& baseurl)
 {
-    // TODO: Implement CSS importing
+    if (url.empty() || !fetch_scheduler) return;
+
+    std::string full_url = resolve_url(url, baseurl.empty() ? page_base_url() : baseurl);
+
+    // litehtml needs the text before it continues parsing, so wait for the
+    // scheduled fetch; stylesheets are queued ahead of every image
+    text = fetch_css(full_url).get();
+
+    if (!text.empty()) {
+        // Nested @import and url() references resolve against the stylesheet itself
+        baseurl = full_url;
+    }
+}
+
+void NFX_Container::preload_css(const std::string& href, const std::string& baseurl)
+{
+    if (href.empty() || !fetch_scheduler) return;
+    fetch_css(resolve_url(href, baseurl));
 }
 
 void NFX_Container::set_clip(const litehtml::position& pos, const litehtml::border_radiuses& bdr_radius)
@@ -553,4 +840,41 @@ void NFX_Container::get_language(litehtml::string& language, litehtml::string& c
 void NFX_Container::set_browser(void* browser_ref)
 {
     this->browser = browser_ref;
+}
+
+void NFX_Container::set_fetch_scheduler(NFX_FetchScheduler* scheduler)
+{
+    this->fetch_scheduler = scheduler;
+}
+
+void NFX_Container::set_resource_cache(NFX_ResourceCache* cache)
+{
+    this->resource_cache = cache;
+}
+
+NFX_TextMeasurer::Stats NFX_Container::get_text_stats()
+{
+    return text_measurer.get_stats();
+}
+
+NFX_TextCache::Stats NFX_Container::get_text_cache_stats()
+{
+    return text_cache.get_stats();
+}
+
+void NFX_Container::set_page(uint64_t page)
+{
+    current_page = page;
+}
+
+void NFX_Container::release_page(uint64_t page)
+{
+    std::lock_guard<std::mutex> lock(pages_mutex);
+    pages.erase(page);
+}
+
+void NFX_Container::clear_imported_css()
+{
+    std::lock_guard<std::mutex> lock(css_mutex);
+    imported_css.clear();
 }
\ No newline at end of file
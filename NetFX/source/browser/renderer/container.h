@@ -4,8 +4,21 @@
 #include <SDL.h>
 #include <SDL_ttf.h>
 #include <map>
+#include <unordered_map>
 #include <string>
 #include <mutex>
+#include <future>
+#include <atomic>
+#include <deque>
+#include "font_manager.h"
+#include "glyph_atlas.h"
+#include "text_cache.h"
+#include "text_measurer.h"
+#include "image_decoder.h"
+#include "resource_cache.h"
+#include "display_list.h"
+#include "../net/fetch_scheduler.h"
+#include "../../bytesize.h"
 
 class NFX_Container : public litehtml::document_container
 {
@@ -14,22 +27,75 @@ private:
     int default_font_size;
     std::string default_font_name;
     void* browser;
-    std::string current_base_url;
-
-    // Image loading structures
-    struct LoadedImage {
-        SDL_Texture* texture = nullptr;
-        int width = 0;
-        int height = 0;
-        bool loaded = false;
+    NFX_FontManager font_manager;
+    NFX_GlyphAtlas glyph_atlas;
+    NFX_TextCache text_cache;
+    NFX_TextMeasurer text_measurer;
+    NFX_FetchScheduler* fetch_scheduler = nullptr;
+    NFX_ResourceCache* resource_cache = nullptr;
+
+    // Page the calling thread is loading, laying out or drawing. New image
+    // requests are charged to it, and srcs and relative URLs are resolved
+    // with its own state.
+    static thread_local uint64_t current_page;
+
+    struct PageState {
+        std::string base_url;
+
+        // litehtml asks for images by their raw src, the cache is keyed by
+        // absolute URL; the same src means different URLs on different pages
+        std::map<std::string, std::string> image_urls;
     };
 
-    std::map<std::string, LoadedImage> loaded_images;
-    std::mutex images_mutex;
+    // Dropped when the page is released
+    std::unordered_map<uint64_t, PageState> pages;
+    std::mutex pages_mutex;
+
+    std::string page_base_url();
+
+    // Workers decode into the renderer's format, the render thread uploads
+    NFX_ImageDecoder image_decoder;
+    SDL_BlendMode image_blend_mode = SDL_BLENDMODE_BLEND;
+
+    struct PendingUpload {
+        std::string url;
+        NFX_DecodedImage image;
+    };
+
+    std::deque<PendingUpload> pending_uploads;
+    std::mutex uploads_mutex;
+
+    // GPU memory for cached text run textures
+    static const size_t TEXT_CACHE_BUDGET = 32 * MiB;
+
+    // At least one image is uploaded per frame, more only within these limits
+    static const size_t UPLOAD_BYTES_PER_FRAME = 8 * MiB;
+    static const int UPLOAD_MS_PER_FRAME = 4;
+
+    // Stylesheets of the current navigation, so partial reparses do not refetch them
+    std::map<std::string, std::shared_future<std::string>> imported_css;
+    std::mutex css_mutex;
+
+    // Paint calls go into this list instead of onto the renderer while it is set
+    NFX_DisplayList* recording = nullptr;
+    std::vector<const NFX_DisplayList::Item*> visible_items;
+
+    void fill_rect(const litehtml::web_color& color, const SDL_Rect& rect);
 
     // Helper methods for image loading
     std::string resolve_url(const std::string& src, const std::string& base_url);
-    void load_image_async(const std::string& url, const std::string& src);
+    void load_image_async(const std::string& url, NFX_FetchPriority priority);
+    void decode_image(const std::string& url, const std::string& bytes);
+    void decode_image_async(const std::string& url, std::shared_ptr<const std::string> bytes, NFX_FetchPriority priority);
+    void request_image(const std::string& src, const std::string& base_url, NFX_FetchPriority priority);
+    std::string find_image_url(const char* src);
+    bool find_image(const char* src, NFX_ResourceCache::Image& image);
+
+    // Images are requested at the off-screen priority; painting one that is
+    // still missing moves its queued fetch ahead
+    void promote_image(const char* src);
+    void draw_background_image(const litehtml::background_paint& layer);
+    std::shared_future<std::string> fetch_css(const std::string& full_url);
 
 public:
     std::map<std::string, TTF_Font*> fonts;
@@ -42,7 +108,10 @@ public:
         litehtml::font_style italic, unsigned int decoration,
         litehtml::font_metrics* fm) override;
     void delete_font(litehtml::uint_ptr hFont) override;
+    // Held around any SDL_ttf call made outside the container
+    std::unique_lock<std::mutex> lock_font(TTF_Font* font);
     int text_width(const char* text, litehtml::uint_ptr hFont) override;
+    void text_widths(const char* const* texts, int* widths, size_t count, litehtml::uint_ptr hFont) override;
     void draw_text(litehtml::uint_ptr hdc, const char* text, litehtml::uint_ptr hFont,
         litehtml::web_color color, const litehtml::position& pos) override;
     int pt_to_px(int pt) const override;
@@ -74,4 +143,29 @@ public:
         const litehtml::position& pos);
 
     void set_browser(void* browser_ref);
+    void set_fetch_scheduler(NFX_FetchScheduler* scheduler);
+    void set_resource_cache(NFX_ResourceCache* cache);
+    NFX_TextMeasurer::Stats get_text_stats();
+    NFX_TextCache::Stats get_text_cache_stats();
+
+    // Creates textures for decoded images; call once per frame on the render thread.
+    // Adds the src of every image that became drawable, as litehtml asked for it
+    void upload_images(litehtml::string_vector& loaded_srcs);
+    bool has_pending_uploads();
+
+    // Records everything the document paints, replay() then draws the part in view
+    void record(const std::shared_ptr<litehtml::document>& doc, NFX_DisplayList& list);
+    void replay(const NFX_DisplayList& list, const SDL_Rect& viewport);
+
+    // Evicts text runs that were not drawn; call after the document is drawn
+    void end_frame();
+    // Selects the page for the calling thread
+    void set_page(uint64_t page);
+    void release_page(uint64_t page);
+    void clear_imported_css();
+
+    // Early fetches started by the preload scanner; the parser's own
+    // load_image/import_css calls later join these instead of refetching
+    void preload_image(const std::string& src, const std::string& baseurl, NFX_FetchPriority priority);
+    void preload_css(const std::string& href, const std::string& baseurl);
 };
\ No newline at end of file
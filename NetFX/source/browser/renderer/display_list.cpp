@@ -0,0 +1,126 @@
+#include "display_list.h"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    bool same_color(const SDL_Color& a, const SDL_Color& b)
+    {
+        return a.r == b.r && a.g == b.g && a.b == b.b && a.a == b.a;
+    }
+
+    bool same_position(const litehtml::position& a, const litehtml::position& b)
+    {
+        return a.x == b.x && a.y == b.y && a.width == b.width && a.height == b.height;
+    }
+
+    bool same_layer(const litehtml::background_paint& a, const litehtml::background_paint& b)
+    {
+        return a.image == b.image && a.color == b.color && a.repeat == b.repeat &&
+            a.position_x == b.position_x && a.position_y == b.position_y &&
+            a.image_size.width == b.image_size.width && a.image_size.height == b.image_size.height &&
+            same_position(a.origin_box, b.origin_box) && same_position(a.border_box, b.border_box);
+    }
+}
+
+void NFX_DisplayList::clear()
+{
+    items.clear();
+    text.clear();
+    layers.clear();
+    bands.clear();
+}
+
+void NFX_DisplayList::add(const Item& item)
+{
+    if (item.bounds.w <= 0 || item.bounds.h <= 0) return;
+
+    uint32_t index = (uint32_t)items.size();
+    items.push_back(item);
+
+    // Anything above the page is kept in the first band
+    int first = std::max(item.bounds.y, 0) / BAND_HEIGHT;
+    int last = std::max(item.bounds.y + item.bounds.h - 1, 0) / BAND_HEIGHT;
+    if ((size_t)last >= bands.size()) {
+        bands.resize(last + 1);
+    }
+    for (int band = first; band <= last; band++) {
+        bands[band].push_back(index);
+    }
+}
+
+void NFX_DisplayList::add_text(TTF_Font* font, const char* run, SDL_Color color, const SDL_Rect& bounds)
+{
+    Item item = { TEXT, bounds, color, font, (uint32_t)text.size() };
+    text.append(run);
+    text.push_back('\0');
+    add(item);
+}
+
+void NFX_DisplayList::add_rect(SDL_Color color, const SDL_Rect& bounds)
+{
+    Item item = { RECT, bounds, color, nullptr, 0 };
+    add(item);
+}
+
+void NFX_DisplayList::add_image(const litehtml::background_paint& layer)
+{
+    SDL_Rect bounds = { layer.clip_box.x, layer.clip_box.y, layer.clip_box.width, layer.clip_box.height };
+    Item item = { IMAGE, bounds, { 0, 0, 0, 0 }, nullptr, (uint32_t)layers.size() };
+    layers.push_back(layer);
+    add(item);
+}
+
+void NFX_DisplayList::query(const SDL_Rect& area, std::vector<const Item*>& out) const
+{
+    out.clear();
+    if (bands.empty() || area.w <= 0 || area.h <= 0) return;
+
+    int first = std::max(area.y, 0) / BAND_HEIGHT;
+    int last = std::min(std::max(area.y + area.h - 1, 0) / BAND_HEIGHT, (int)bands.size() - 1);
+
+    // Items spanning several bands are listed in each, indices restore paint order
+    std::vector<uint32_t> indices;
+    for (int band = first; band <= last; band++) {
+        indices.insert(indices.end(), bands[band].begin(), bands[band].end());
+    }
+    if (first != last) {
+        std::sort(indices.begin(), indices.end());
+        indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+    }
+
+    for (uint32_t index : indices) {
+        const Item& item = items[index];
+        if (SDL_HasIntersection(&item.bounds, &area)) {
+            out.push_back(&item);
+        }
+    }
+}
+
+bool NFX_DisplayList::same_layout(const NFX_DisplayList& other, litehtml::position::vector& changed) const
+{
+    if (items.size() != other.items.size()) return false;
+
+    for (size_t i = 0; i < items.size(); i++) {
+        const Item& a = items[i];
+        const Item& b = other.items[i];
+        if (a.type != b.type || !SDL_RectEquals(&a.bounds, &b.bounds)) return false;
+
+        bool same = false;
+        switch (a.type) {
+        case TEXT:
+            same = a.font == b.font && same_color(a.color, b.color) && std::strcmp(get_text(a), other.get_text(b)) == 0;
+            break;
+        case RECT:
+            same = same_color(a.color, b.color);
+            break;
+        case IMAGE:
+            same = same_layer(get_layer(a), other.get_layer(b));
+            break;
+        }
+        if (!same) {
+            changed.emplace_back(b.bounds.x, b.bounds.y, b.bounds.w, b.bounds.h);
+        }
+    }
+    return true;
+}
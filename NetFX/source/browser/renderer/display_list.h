@@ -0,0 +1,61 @@
+#pragma once
+
+#include <SDL.h>
+#include <SDL_ttf.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <litehtml.h>
+
+// Flat record of everything a laid out document paints, in paint order.
+// It is recorded once after layout or restyle and replayed every frame, so
+// repainting an unchanged page does not walk the render tree again. Items
+// are bucketed by vertical bands so replay only visits the visible ones.
+class NFX_DisplayList
+{
+public:
+    enum ItemType : Uint8 {
+        TEXT,       // Text run drawn with font at the top left of bounds
+        RECT,       // Filled rectangle, also used for border sides and list bullets
+        IMAGE       // Background layer, <img> elements included
+    };
+
+    struct Item {
+        ItemType type;
+        SDL_Rect bounds;
+        SDL_Color color;
+        TTF_Font* font;     // TEXT only
+        uint32_t payload;   // Offset into the text buffer, or index of the image layer
+    };
+
+private:
+    static const int BAND_HEIGHT = 512;
+
+    std::vector<Item> items;
+    std::string text;
+    std::vector<litehtml::background_paint> layers;
+
+    // Indices of the items overlapping each band, in paint order
+    std::vector<std::vector<uint32_t>> bands;
+
+    void add(const Item& item);
+
+public:
+    void clear();
+    bool empty() const { return items.empty(); }
+    size_t size() const { return items.size(); }
+
+    void add_text(TTF_Font* font, const char* text, SDL_Color color, const SDL_Rect& bounds);
+    void add_rect(SDL_Color color, const SDL_Rect& bounds);
+    void add_image(const litehtml::background_paint& layer);
+
+    // Items intersecting the area, in paint order
+    void query(const SDL_Rect& area, std::vector<const Item*>& out) const;
+
+    // Whether other holds the same items at the same bounds; the bounds of
+    // those it paints differently (color, text, font, image) go to changed
+    bool same_layout(const NFX_DisplayList& other, litehtml::position::vector& changed) const;
+
+    const char* get_text(const Item& item) const { return text.c_str() + item.payload; }
+    const litehtml::background_paint& get_layer(const Item& item) const { return layers[item.payload]; }
+};
@@ -0,0 +1,300 @@
+#include "font_manager.h"
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <filesystem>
+#include <iostream>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    std::string to_lower(std::string text)
+    {
+        std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+        return text;
+    }
+
+    // "SemiBold Italic" -> 600, italic; the face's own name is the only hint SDL_ttf offers
+    void parse_style_name(const char* style_name, int& weight, bool& italic)
+    {
+        std::string style;
+        for (const char* c = style_name ? style_name : ""; *c; c++) {
+            if (*c != ' ' && *c != '-' && *c != '_') style += (char)std::tolower((unsigned char)*c);
+        }
+
+        auto has = [&style](const char* word) { return style.find(word) != std::string::npos; };
+
+        if (has("thin") || has("hairline")) weight = 100;
+        else if (has("extralight") || has("ultralight")) weight = 200;
+        else if (has("semibold") || has("demibold")) weight = 600;
+        else if (has("extrabold") || has("ultrabold")) weight = 800;
+        else if (has("black") || has("heavy")) weight = 900;
+        else if (has("light")) weight = 300;
+        else if (has("medium")) weight = 500;
+        else if (has("bold")) weight = 700;
+        else weight = 400;
+
+        italic = has("italic") || has("oblique");
+    }
+
+    // Looks for substitution and positioning tables in the sfnt table directory
+    // of one face; collections point at each face's directory from their header
+    bool find_layout_tables(const unsigned char* data, size_t size, long index)
+    {
+        auto read32 = [&](size_t at) -> uint32_t {
+            return at + 4 <= size ? (uint32_t)data[at] << 24 | data[at + 1] << 16 | data[at + 2] << 8 | data[at + 3] : 0;
+        };
+
+        size_t directory = 0;
+        if (read32(0) == 0x74746366) { // 'ttcf'
+            if ((uint32_t)index >= read32(8)) return false;
+            directory = read32(12 + 4 * (size_t)index);
+        }
+
+        size_t tables = read32(directory + 4) >> 16;
+        for (size_t i = 0; i < tables; i++) {
+            switch (read32(directory + 12 + 16 * i)) {
+            case 0x47535542: // 'GSUB'
+            case 0x47504F53: // 'GPOS'
+            case 0x6D6F7278: // 'morx'
+            case 0x6D6F7274: // 'mort'
+            case 0x6B657278: // 'kerx'
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool is_generic_family(const std::string& family)
+    {
+        return family == "serif" || family == "sans-serif" || family == "monospace" || family == "cursive" ||
+            family == "fantasy" || family == "system-ui" || family.compare(0, 3, "ui-") == 0;
+    }
+
+    // CSS font matching: 400 tries 500 first, 500 tries 400; lighter
+    // requests then look further down, heavier ones further up
+    int weight_distance(int desired, int available)
+    {
+        if (available == desired) return 0;
+        if (desired >= 400 && desired <= 500 && available > desired && available <= 500) return available - desired;
+        if (desired <= 500) {
+            return available < desired ? 1000 + desired - available : 2000 + available - desired;
+        }
+        return available > desired ? 1000 + available - desired : 2000 + desired - available;
+    }
+}
+
+NFX_FontManager::NFX_FontManager(const std::string& default_file)
+{
+    index_directory(".");
+    index_directory("fonts");
+
+    for (size_t i = 0; i < faces.size(); i++) {
+        if (fs::path(faces[i].path).filename() == default_file) {
+            default_face = i;
+            break;
+        }
+    }
+
+    std::cout << "Indexed " << faces.size() << " font faces in " << families.size() << " families" << std::endl;
+}
+
+NFX_FontManager::~NFX_FontManager()
+{
+    for (auto& instance : instances) {
+        TTF_CloseFont(instance.second.font);
+    }
+}
+
+void NFX_FontManager::index_directory(const std::string& directory)
+{
+    std::error_code ec;
+    for (fs::directory_iterator it(directory, ec), end; !ec && it != end; it.increment(ec)) {
+        if (!it->is_regular_file(ec)) continue;
+
+        std::string extension = to_lower(it->path().extension().string());
+        if (extension == ".ttf" || extension == ".otf" || extension == ".ttc") {
+            index_file(it->path().string());
+        }
+    }
+}
+
+void NFX_FontManager::index_file(const std::string& path)
+{
+    httplib::detail::mmap file(path.c_str());
+    if (!file.is_open() || file.size() == 0) return;
+
+    // Collections hold several faces, each is indexed on its own
+    long face_count = 1;
+    for (long index = 0; index < face_count; index++) {
+        SDL_RWops* rw = SDL_RWFromConstMem(file.data(), (int)file.size());
+        TTF_Font* font = rw ? TTF_OpenFontIndexRW(rw, 1, 12, index) : nullptr;
+        if (!font) break;
+
+        face_count = TTF_FontFaces(font);
+
+        Face face;
+        face.path = path;
+        face.index = index;
+        const char* family = TTF_FontFaceFamilyName(font);
+        face.family = to_lower(family ? family : fs::path(path).stem().string());
+        parse_style_name(TTF_FontFaceStyleName(font), face.weight, face.italic);
+        face.layout_tables = find_layout_tables((const unsigned char*)file.data(), file.size(), index);
+        TTF_CloseFont(font);
+
+        families[face.family].push_back(faces.size());
+        faces.push_back(std::move(face));
+    }
+}
+
+bool NFX_FontManager::map_face(Face& face)
+{
+    if (face.data) return true;
+
+    // Mapped for as long as the manager lives, FreeType reads glyphs from it lazily
+    auto data = std::make_unique<httplib::detail::mmap>(face.path.c_str());
+    if (!data->is_open() || data->size() == 0) {
+        std::cout << "Failed to map font: " << face.path << std::endl;
+        return false;
+    }
+
+    face.data = std::move(data);
+    return true;
+}
+
+size_t NFX_FontManager::match_family(const std::vector<size_t>& candidates, int weight, bool italic) const
+{
+    size_t best = candidates.front();
+    int best_score = INT_MAX;
+
+    for (size_t index : candidates) {
+        const Face& face = faces[index];
+        int score = weight_distance(weight, face.weight) + (face.italic != italic ? 10000 : 0);
+        if (score < best_score) {
+            best = index;
+            best_score = score;
+        }
+    }
+
+    return best;
+}
+
+size_t NFX_FontManager::match(const char* family_list, int weight, bool italic) const
+{
+    const std::vector<size_t>& fallback = families.at(faces[default_face].family);
+
+    std::string list = family_list ? family_list : "";
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t end = list.find(',', start);
+        if (end == std::string::npos) end = list.size();
+
+        std::string family = list.substr(start, end - start);
+        size_t first = family.find_first_not_of(" \t\"'");
+        size_t last = family.find_last_not_of(" \t\"'");
+        family = first == std::string::npos ? "" : to_lower(family.substr(first, last - first + 1));
+
+        if (!family.empty()) {
+            if (is_generic_family(family)) {
+                return match_family(fallback, weight, italic);
+            }
+
+            auto it = families.find(family);
+            if (it != families.end()) {
+                return match_family(it->second, weight, italic);
+            }
+        }
+
+        start = end + 1;
+    }
+
+    return match_family(fallback, weight, italic);
+}
+
+uint64_t NFX_FontManager::instance_key(size_t face, int size, int style)
+{
+    // face:32 size:24 style:8
+    return ((uint64_t)face << 32) | ((uint64_t)(size & 0xFFFFFF) << 8) | (uint64_t)(style & 0xFF);
+}
+
+TTF_Font* NFX_FontManager::acquire(const char* family_list, int size, int weight, bool italic)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (faces.empty() || size <= 0) return nullptr;
+
+    size_t index = match(family_list, weight, italic);
+    Face& face = faces[index];
+
+    int style = TTF_STYLE_NORMAL;
+    if (weight >= 600 && face.weight < 600) style |= TTF_STYLE_BOLD;
+    if (italic && !face.italic) style |= TTF_STYLE_ITALIC;
+
+    uint64_t key = instance_key(index, size, style);
+    auto it = instances.find(key);
+    if (it != instances.end()) {
+        it->second.references++;
+        return it->second.font;
+    }
+
+    if (!map_face(face)) return nullptr;
+
+    SDL_RWops* rw = SDL_RWFromConstMem(face.data->data(), (int)face.data->size());
+    TTF_Font* font = rw ? TTF_OpenFontIndexRW(rw, 1, size, face.index) : nullptr;
+    if (!font) {
+        std::cout << "Failed to open font " << face.path << " at " << size << "px: " << TTF_GetError() << std::endl;
+        return nullptr;
+    }
+    TTF_SetFontStyle(font, style);
+
+    instances[key] = { font, 1 };
+    instance_keys[font] = key;
+    {
+        std::lock_guard<std::mutex> locks_lock(font_locks_mutex);
+        font_locks[font] = std::make_shared<std::mutex>();
+        font_layout_tables[font] = face.layout_tables;
+    }
+    return font;
+}
+
+void NFX_FontManager::release(TTF_Font* font)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto key = instance_keys.find(font);
+    if (key == instance_keys.end()) return;
+
+    auto it = instances.find(key->second);
+    if (--it->second.references > 0) return;
+
+    if (on_close) on_close(font);
+    TTF_CloseFont(font);
+    instances.erase(it);
+    instance_keys.erase(key);
+
+    std::lock_guard<std::mutex> locks_lock(font_locks_mutex);
+    font_locks.erase(font);
+    font_layout_tables.erase(font);
+}
+
+std::unique_lock<std::mutex> NFX_FontManager::lock_font(TTF_Font* font)
+{
+    std::shared_ptr<std::mutex> font_lock;
+    {
+        std::lock_guard<std::mutex> locks_lock(font_locks_mutex);
+        auto it = font_locks.find(font);
+        if (it == font_locks.end()) return std::unique_lock<std::mutex>();
+        font_lock = it->second;
+    }
+
+    // The caller holds a reference to the font, so the instance outlives the lock
+    return std::unique_lock<std::mutex>(*font_lock);
+}
+
+bool NFX_FontManager::has_layout_tables(TTF_Font* font)
+{
+    std::lock_guard<std::mutex> locks_lock(font_locks_mutex);
+    auto it = font_layout_tables.find(font);
+    return it == font_layout_tables.end() || it->second;
+}
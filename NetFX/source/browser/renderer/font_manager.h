@@ -0,0 +1,82 @@
+#pragma once
+
+#include <httplib.hpp>
+#include <SDL_ttf.h>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Indexes the font files next to the executable and in fonts/ by family,
+// weight and style. Every file is memory mapped once; sized instances are
+// opened from that mapping and shared by everyone asking for the same size.
+class NFX_FontManager
+{
+private:
+    struct Face {
+        std::string path;
+        long index = 0;             // Face inside a .ttc collection
+        std::string family;         // Lower case
+        int weight = 400;
+        bool italic = false;
+        bool layout_tables = false; // GSUB, GPOS or AAT tables a shaper would apply
+        std::unique_ptr<httplib::detail::mmap> data;
+    };
+
+    struct Instance {
+        TTF_Font* font = nullptr;
+        int references = 0;
+    };
+
+    std::vector<Face> faces;
+    std::unordered_map<std::string, std::vector<size_t>> families;
+    size_t default_face = 0;
+
+    std::unordered_map<uint64_t, Instance> instances;
+    std::unordered_map<TTF_Font*, uint64_t> instance_keys;
+    std::mutex mutex;
+
+    // Kept apart from mutex: lock_font and has_layout_tables are called with
+    // other caches' locks held, while release() calls into those caches with
+    // mutex held
+    std::unordered_map<TTF_Font*, std::shared_ptr<std::mutex>> font_locks;
+    std::unordered_map<TTF_Font*, bool> font_layout_tables;
+    std::mutex font_locks_mutex;
+
+    void index_directory(const std::string& directory);
+    void index_file(const std::string& path);
+    bool map_face(Face& face);
+
+    // Best face for a CSS font-family list; falls back to the default face
+    size_t match(const char* family_list, int weight, bool italic) const;
+    size_t match_family(const std::vector<size_t>& candidates, int weight, bool italic) const;
+
+    static uint64_t instance_key(size_t face, int size, int style);
+
+public:
+    // Called before a font is closed so per-font caches can drop it
+    std::function<void(TTF_Font*)> on_close;
+
+    NFX_FontManager(const std::string& default_file);
+    ~NFX_FontManager();
+
+    // Shared instance for the closest matching face; weight and italic the
+    // face lacks are synthesized. Every acquire needs a release.
+    TTF_Font* acquire(const char* family_list, int size, int weight, bool italic);
+    void release(TTF_Font* font);
+
+    // Instances are shared by the UI thread and layout workers, and neither
+    // FreeType faces nor SDL_ttf's glyph cache are thread safe. Hold this
+    // around every TTF call on a font; only the TTF call itself, never
+    // while waiting for another lock. Fonts not from acquire() get no lock.
+    std::unique_lock<std::mutex> lock_font(TTF_Font* font);
+
+    // Whether the face has OpenType or AAT layout tables, which HarfBuzz
+    // applies across whole runs; true for fonts not from acquire()
+    bool has_layout_tables(TTF_Font* font);
+
+    size_t face_count() const { return faces.size(); }
+};
@@ -0,0 +1,268 @@
+#include "glyph_atlas.h"
+#include <algorithm>
+
+NFX_GlyphAtlas::NFX_GlyphAtlas(SDL_Renderer* renderer) : renderer(renderer)
+{
+}
+
+NFX_GlyphAtlas::~NFX_GlyphAtlas()
+{
+    for (auto& page : pages) {
+        if (page.texture) {
+            SDL_DestroyTexture(page.texture);
+        }
+    }
+}
+
+Uint32 NFX_GlyphAtlas::decode_utf8(const char*& text)
+{
+    const unsigned char* s = reinterpret_cast<const unsigned char*>(text);
+    Uint32 cp = 0xFFFD;
+    int length = 1;
+
+    if (s[0] < 0x80) {
+        cp = s[0];
+    }
+    else if ((s[0] & 0xE0) == 0xC0 && (s[1] & 0xC0) == 0x80) {
+        cp = ((s[0] & 0x1F) << 6) | (s[1] & 0x3F);
+        length = 2;
+    }
+    else if ((s[0] & 0xF0) == 0xE0 && (s[1] & 0xC0) == 0x80 && (s[2] & 0xC0) == 0x80) {
+        cp = ((s[0] & 0x0F) << 12) | ((s[1] & 0x3F) << 6) | (s[2] & 0x3F);
+        length = 3;
+    }
+    else if ((s[0] & 0xF8) == 0xF0 && (s[1] & 0xC0) == 0x80 && (s[2] & 0xC0) == 0x80 && (s[3] & 0xC0) == 0x80) {
+        cp = ((s[0] & 0x07) << 18) | ((s[1] & 0x3F) << 12) | ((s[2] & 0x3F) << 6) | (s[3] & 0x3F);
+        length = 4;
+    }
+
+    text += length;
+    return cp;
+}
+
+bool NFX_GlyphAtlas::add_page()
+{
+    if ((int)pages.size() >= MAX_PAGES) return false;
+
+    SDL_Texture* texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888,
+        SDL_TEXTUREACCESS_STATIC, PAGE_SIZE, PAGE_SIZE);
+    if (!texture) return false;
+
+    SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+    SDL_SetTextureScaleMode(texture, SDL_ScaleModeNearest);
+
+    Page page;
+    page.texture = texture;
+    pages.push_back(std::move(page));
+    return true;
+}
+
+bool NFX_GlyphAtlas::allocate(int width, int height, int& page_index, SDL_Rect& rect)
+{
+    // Glyphs are packed into shelves; one pixel of padding keeps neighbours apart
+    int padded_w = width + 1;
+    int padded_h = height + 1;
+    if (padded_w > PAGE_SIZE || padded_h > PAGE_SIZE) return false;
+
+    if (pages.empty() && !add_page()) return false;
+
+    Page* page = &pages.back();
+
+    if (page->shelf_x + padded_w > PAGE_SIZE) {
+        page->shelf_y += page->shelf_height;
+        page->shelf_x = 0;
+        page->shelf_height = 0;
+    }
+
+    if (page->shelf_y + padded_h > PAGE_SIZE) {
+        if (!add_page()) return false;
+        page = &pages.back();
+    }
+
+    rect = { page->shelf_x, page->shelf_y, width, height };
+    page_index = (int)pages.size() - 1;
+
+    page->shelf_x += padded_w;
+    page->shelf_height = std::max(page->shelf_height, padded_h);
+    return true;
+}
+
+void NFX_GlyphAtlas::reset()
+{
+    // Pending quads reference the old layout, so submit them first
+    flush();
+
+    glyphs.clear();
+    for (auto& page : pages) {
+        page.shelf_x = 0;
+        page.shelf_y = 0;
+        page.shelf_height = 0;
+    }
+
+    // Keep the first page, the rest are recreated on demand
+    while (pages.size() > 1) {
+        SDL_DestroyTexture(pages.back().texture);
+        pages.pop_back();
+    }
+}
+
+const NFX_GlyphAtlas::Glyph* NFX_GlyphAtlas::get_glyph(TTF_Font* font, Uint32 codepoint)
+{
+    GlyphKey key = { font, codepoint };
+    auto it = glyphs.find(key);
+    if (it != glyphs.end()) {
+        return &it->second;
+    }
+
+    int minx, maxx, miny, maxy, advance;
+    if (TTF_GlyphMetrics32(font, codepoint, &minx, &maxx, &miny, &maxy, &advance) != 0) {
+        return nullptr;
+    }
+
+    Glyph glyph;
+    glyph.advance = advance;
+    glyph.offset_x = std::min(0, minx);
+
+    SDL_Color white = { 255, 255, 255, 255 };
+    SDL_Surface* surface = TTF_RenderGlyph32_Blended(font, codepoint, white);
+
+    if (surface && surface->w > 0 && surface->h > 0 && maxx > minx) {
+        if (surface->format->format != SDL_PIXELFORMAT_ARGB8888) {
+            SDL_Surface* converted = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_ARGB8888, 0);
+            SDL_FreeSurface(surface);
+            surface = converted;
+        }
+
+        int page_index;
+        SDL_Rect rect;
+        bool placed = surface && allocate(surface->w, surface->h, page_index, rect);
+        if (surface && !placed) {
+            // Atlas is full, start over and try once more
+            reset();
+            placed = allocate(surface->w, surface->h, page_index, rect);
+        }
+
+        if (placed) {
+            SDL_UpdateTexture(pages[page_index].texture, &rect, surface->pixels, surface->pitch);
+            glyph.page = page_index;
+            glyph.rect = rect;
+        }
+    }
+
+    if (surface) {
+        SDL_FreeSurface(surface);
+    }
+
+    return &(glyphs[key] = glyph);
+}
+
+template <typename F>
+void NFX_GlyphAtlas::for_each_glyph(TTF_Font* font, const char* text, F&& callback)
+{
+    bool kerning = TTF_GetFontKerning(font) != 0;
+    int pen_x = 0;
+    Uint32 previous = 0;
+
+    while (*text) {
+        Uint32 codepoint = decode_utf8(text);
+
+        if (kerning && previous) {
+            pen_x += TTF_GetFontKerningSizeGlyphs32(font, previous, codepoint);
+        }
+        previous = codepoint;
+
+        const Glyph* glyph = get_glyph(font, codepoint);
+        if (!glyph) continue;
+
+        callback(*glyph, pen_x);
+        pen_x += glyph->advance;
+    }
+}
+
+void NFX_GlyphAtlas::draw_text(TTF_Font* font, const char* text, SDL_Color color, int x, int y)
+{
+    if (!font || !text || !renderer) return;
+
+    std::unique_lock<std::mutex> font_lock;
+    if (lock_font) font_lock = lock_font(font);
+
+    for_each_glyph(font, text, [&](const Glyph& glyph, int pen_x) {
+        if (glyph.page < 0) return;
+
+        Page& page = pages[glyph.page];
+
+        float x0 = (float)(x + pen_x + glyph.offset_x);
+        float y0 = (float)y;
+        float x1 = x0 + glyph.rect.w;
+        float y1 = y0 + glyph.rect.h;
+
+        float u0 = (float)glyph.rect.x / PAGE_SIZE;
+        float v0 = (float)glyph.rect.y / PAGE_SIZE;
+        float u1 = (float)(glyph.rect.x + glyph.rect.w) / PAGE_SIZE;
+        float v1 = (float)(glyph.rect.y + glyph.rect.h) / PAGE_SIZE;
+
+        int base = (int)page.vertices.size();
+        page.vertices.push_back({ { x0, y0 }, color, { u0, v0 } });
+        page.vertices.push_back({ { x1, y0 }, color, { u1, v0 } });
+        page.vertices.push_back({ { x1, y1 }, color, { u1, v1 } });
+        page.vertices.push_back({ { x0, y1 }, color, { u0, v1 } });
+
+        int quad[6] = { base, base + 1, base + 2, base, base + 2, base + 3 };
+        page.indices.insert(page.indices.end(), quad, quad + 6);
+    });
+
+    flush();
+}
+
+SDL_Rect NFX_GlyphAtlas::text_bounds(TTF_Font* font, const char* text)
+{
+    SDL_Rect bounds = { 0, 0, 0, 0 };
+    if (!font || !text) return bounds;
+
+    int left = 0;
+    int right = 0;
+    int bottom = 0;
+    bool first = true;
+
+    std::unique_lock<std::mutex> font_lock;
+    if (lock_font) font_lock = lock_font(font);
+
+    for_each_glyph(font, text, [&](const Glyph& glyph, int pen_x) {
+        if (glyph.page < 0) return;
+
+        int x0 = pen_x + glyph.offset_x;
+        left = first ? x0 : std::min(left, x0);
+        right = first ? x0 + glyph.rect.w : std::max(right, x0 + glyph.rect.w);
+        bottom = std::max(bottom, glyph.rect.h);
+        first = false;
+    });
+
+    bounds = { left, 0, right - left, bottom };
+    return bounds;
+}
+
+void NFX_GlyphAtlas::flush()
+{
+    for (auto& page : pages) {
+        if (page.indices.empty()) continue;
+
+        SDL_RenderGeometry(renderer, page.texture,
+            page.vertices.data(), (int)page.vertices.size(),
+            page.indices.data(), (int)page.indices.size());
+
+        page.vertices.clear();
+        page.indices.clear();
+    }
+}
+
+void NFX_GlyphAtlas::release_font(TTF_Font* font)
+{
+    for (auto it = glyphs.begin(); it != glyphs.end(); ) {
+        if (it->first.font == font) {
+            it = glyphs.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+}
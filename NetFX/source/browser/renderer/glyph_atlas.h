@@ -0,0 +1,82 @@
+#pragma once
+
+#include <SDL.h>
+#include <SDL_ttf.h>
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+
+// Caches rasterized glyphs in a few large textures so text runs can be
+// drawn as a batch of quads instead of one texture upload per word.
+class NFX_GlyphAtlas
+{
+private:
+    static const int PAGE_SIZE = 1024;
+    static const int MAX_PAGES = 8;
+
+    struct Glyph {
+        int page = -1;          // -1 for glyphs without pixels (spaces)
+        SDL_Rect rect = { 0, 0, 0, 0 };
+        int offset_x = 0;       // Left bearing relative to the pen position
+        int advance = 0;
+    };
+
+    struct Page {
+        SDL_Texture* texture = nullptr;
+        int shelf_x = 0;
+        int shelf_y = 0;
+        int shelf_height = 0;
+        std::vector<SDL_Vertex> vertices;
+        std::vector<int> indices;
+    };
+
+    struct GlyphKey {
+        TTF_Font* font;
+        Uint32 codepoint;
+
+        bool operator==(const GlyphKey& other) const {
+            return font == other.font && codepoint == other.codepoint;
+        }
+    };
+
+    struct GlyphKeyHash {
+        size_t operator()(const GlyphKey& key) const {
+            return std::hash<uintptr_t>()(reinterpret_cast<uintptr_t>(key.font)) ^
+                (static_cast<size_t>(key.codepoint) * 0x9E3779B1u);
+        }
+    };
+
+    SDL_Renderer* renderer;
+    std::vector<Page> pages;
+    std::unordered_map<GlyphKey, Glyph, GlyphKeyHash> glyphs;
+
+    const Glyph* get_glyph(TTF_Font* font, Uint32 codepoint);
+    bool allocate(int width, int height, int& page_index, SDL_Rect& rect);
+    bool add_page();
+    void reset();
+    void flush();
+
+    // Walks the pen over the text; callback(glyph, pen_x) with pen_x relative to the start
+    template <typename F>
+    void for_each_glyph(TTF_Font* font, const char* text, F&& callback);
+
+public:
+    // Serializes SDL_ttf calls on fonts shared with layout workers; held for a whole run
+    std::function<std::unique_lock<std::mutex>(TTF_Font*)> lock_font;
+
+    NFX_GlyphAtlas(SDL_Renderer* renderer);
+    ~NFX_GlyphAtlas();
+
+    // Draws a UTF-8 run with its top-left corner at (x, y)
+    void draw_text(TTF_Font* font, const char* text, SDL_Color color, int x, int y);
+
+    // Box covered by the drawn glyphs, relative to the position given to draw_text
+    SDL_Rect text_bounds(TTF_Font* font, const char* text);
+
+    // Drops cached glyphs of a font that is about to be closed
+    void release_font(TTF_Font* font);
+
+    static Uint32 decode_utf8(const char*& text);
+};
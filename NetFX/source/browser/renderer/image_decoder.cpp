@@ -0,0 +1,112 @@
+#include "image_decoder.h"
+#include <SDL_image.h>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define NFX_HAVE_SSE2
+#include <emmintrin.h>
+#endif
+
+NFX_ImageDecoder::NFX_ImageDecoder(Uint32 format, bool premultiply)
+    : format(format), premultiply(premultiply)
+{
+}
+
+bool NFX_ImageDecoder::decode(const std::string& bytes, NFX_DecodedImage& image) const
+{
+    SDL_RWops* rw = SDL_RWFromConstMem(bytes.data(), (int)bytes.size());
+    if (!rw) return false;
+
+    SDL_Surface* surface = IMG_Load_RW(rw, 1); // This frees the RWops
+    if (!surface) return false;
+
+    // Bring every source format (palettes, RGB24, ...) into RGBA byte order first
+    if (surface->format->format != SDL_PIXELFORMAT_RGBA32) {
+        SDL_Surface* converted = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGBA32, 0);
+        SDL_FreeSurface(surface);
+        if (!converted) return false;
+        surface = converted;
+    }
+
+    image.width = surface->w;
+    image.height = surface->h;
+    image.format = format;
+    image.pixels.resize((size_t)surface->w * surface->h);
+
+    bool swap_rb = format == SDL_PIXELFORMAT_ARGB8888;
+
+    SDL_LockSurface(surface);
+    const Uint8* row = static_cast<const Uint8*>(surface->pixels);
+    for (int y = 0; y < surface->h; y++) {
+        convert_rgba(row, image.pixels.data() + (size_t)y * surface->w, surface->w, swap_rb, premultiply);
+        row += surface->pitch;
+    }
+    SDL_UnlockSurface(surface);
+
+    SDL_FreeSurface(surface);
+    return true;
+}
+
+void NFX_ImageDecoder::convert_rgba(const Uint8* src, Uint32* dst, size_t count, bool swap_rb, bool premultiply)
+{
+    size_t i = 0;
+
+#ifdef NFX_HAVE_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i alpha_mask = _mm_set1_epi32((int)0xFF000000);
+    const __m128i bias = _mm_set1_epi16(128);
+
+    // Four pixels at a time, widened to 16 bits per channel
+    for (; i + 4 <= count; i += 4) {
+        __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+
+        bool opaque = _mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(px, alpha_mask), alpha_mask)) == 0xFFFF;
+        if (!swap_rb && (opaque || !premultiply)) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), px);
+            continue;
+        }
+
+        __m128i lo = _mm_unpacklo_epi8(px, zero);
+        __m128i hi = _mm_unpackhi_epi8(px, zero);
+
+        if (swap_rb) {
+            lo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(lo, _MM_SHUFFLE(3, 0, 1, 2)), _MM_SHUFFLE(3, 0, 1, 2));
+            hi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(hi, _MM_SHUFFLE(3, 0, 1, 2)), _MM_SHUFFLE(3, 0, 1, 2));
+        }
+
+        if (premultiply && !opaque) {
+            __m128i alpha_lo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(lo, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+            __m128i alpha_hi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(hi, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+
+            // c * a / 255, rounded: t = c * a + 128; (t + (t >> 8)) >> 8
+            lo = _mm_add_epi16(_mm_mullo_epi16(lo, alpha_lo), bias);
+            hi = _mm_add_epi16(_mm_mullo_epi16(hi, alpha_hi), bias);
+            lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+            hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+        }
+
+        __m128i out = _mm_packus_epi16(lo, hi);
+        if (premultiply && !opaque) {
+            // Alpha itself must stay unscaled
+            out = _mm_or_si128(_mm_andnot_si128(alpha_mask, out), _mm_and_si128(alpha_mask, px));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), out);
+    }
+#endif
+
+    for (; i < count; i++) {
+        Uint32 r = src[i * 4 + 0];
+        Uint32 g = src[i * 4 + 1];
+        Uint32 b = src[i * 4 + 2];
+        Uint32 a = src[i * 4 + 3];
+
+        if (premultiply && a != 255) {
+            r = r * a + 128; r = (r + (r >> 8)) >> 8;
+            g = g * a + 128; g = (g + (g >> 8)) >> 8;
+            b = b * a + 128; b = (b + (b >> 8)) >> 8;
+        }
+
+        dst[i] = swap_rb ? (a << 24) | (r << 16) | (g << 8) | b
+                         : (a << 24) | (b << 16) | (g << 8) | r;
+    }
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <SDL.h>
+#include <string>
+#include <vector>
+
+// Pixels ready to be copied into a texture without further conversion
+struct NFX_DecodedImage
+{
+    int width = 0;
+    int height = 0;
+    Uint32 format = SDL_PIXELFORMAT_UNKNOWN;
+    std::vector<Uint32> pixels;     // Tightly packed, pitch is width * 4
+};
+
+// Decodes images on any thread straight into the pixel format the renderer
+// uploads natively, so the render thread only has to copy bytes.
+class NFX_ImageDecoder
+{
+private:
+    Uint32 format;
+    bool premultiply;
+
+public:
+    // format must be SDL_PIXELFORMAT_ARGB8888 or SDL_PIXELFORMAT_ABGR8888
+    NFX_ImageDecoder(Uint32 format, bool premultiply);
+
+    bool decode(const std::string& bytes, NFX_DecodedImage& image) const;
+
+    // Converts RGBA byte order pixels to 32-bit ARGB (swap_rb) or ABGR,
+    // optionally premultiplying the color channels by alpha
+    static void convert_rgba(const Uint8* src, Uint32* dst, size_t count, bool swap_rb, bool premultiply);
+};
@@ -0,0 +1,212 @@
+#include "resource_cache.h"
+#include <algorithm>
+#include <vector>
+
+NFX_ResourceCache::NFX_ResourceCache(size_t max_encoded_bytes, size_t max_texture_bytes)
+    : max_encoded_bytes(max_encoded_bytes), max_texture_bytes(max_texture_bytes)
+{
+}
+
+NFX_ResourceCache::~NFX_ResourceCache()
+{
+    for (auto& pair : resources) {
+        if (pair.second.texture) {
+            SDL_DestroyTexture(pair.second.texture);
+        }
+    }
+}
+
+bool NFX_ResourceCache::is_in_use(const Resource& resource) const
+{
+    return resource.state == Resource::LOADING || !resource.pages.empty();
+}
+
+NFX_ResourceCache::Action NFX_ResourceCache::request(const std::string& url, uint64_t page)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto it = resources.find(url);
+    if (it == resources.end()) {
+        Resource& resource = resources[url];
+        resource.last_used = ++clock;
+        if (active_pages.count(page)) resource.pages.insert(page);
+        stats.misses++;
+        return FETCH;
+    }
+
+    Resource& resource = it->second;
+    resource.last_used = ++clock;
+    if (active_pages.count(page)) resource.pages.insert(page);
+    stats.hits++;
+
+    if (resource.state == Resource::READY && !resource.texture && resource.encoded) {
+        // Claim the decode so concurrent requests do not repeat it
+        resource.state = Resource::LOADING;
+        return DECODE;
+    }
+    if (resource.state == Resource::READY && !resource.texture) {
+        // Both the texture and the bytes are gone, download again
+        resource.state = Resource::LOADING;
+        return FETCH;
+    }
+    return NONE;
+}
+
+void NFX_ResourceCache::set_encoded(const std::string& url, std::shared_ptr<const std::string> bytes)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    Resource& resource = resources[url];
+    if (resource.encoded) {
+        stats.encoded_bytes -= resource.encoded->size();
+    }
+    resource.encoded = std::move(bytes);
+    if (resource.encoded) {
+        stats.encoded_bytes += resource.encoded->size();
+    }
+}
+
+void NFX_ResourceCache::set_texture(const std::string& url, SDL_Texture* texture, int width, int height)
+{
+    SDL_Texture* replaced = nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        Resource& resource = resources[url];
+        replaced = resource.texture;
+        stats.texture_bytes -= resource.texture_bytes;
+
+        resource.texture = texture;
+        resource.width = width;
+        resource.height = height;
+        resource.texture_bytes = (size_t)width * height * 4;
+        resource.state = Resource::READY;
+        resource.last_used = ++clock;
+        stats.texture_bytes += resource.texture_bytes;
+    }
+
+    if (replaced && replaced != texture) {
+        SDL_DestroyTexture(replaced);
+    }
+}
+
+void NFX_ResourceCache::set_failed(const std::string& url)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    resources[url].state = Resource::FAILED;
+}
+
+void NFX_ResourceCache::forget(const std::string& url)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto it = resources.find(url);
+    if (it == resources.end() || it->second.state != Resource::LOADING) return;
+
+    if (it->second.texture || it->second.encoded) {
+        // Only the re-decode was cancelled, keep what is cached
+        it->second.state = Resource::READY;
+        return;
+    }
+    resources.erase(it);
+}
+
+bool NFX_ResourceCache::get_image(const std::string& url, Image& image)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto it = resources.find(url);
+    if (it == resources.end() || !it->second.texture) return false;
+
+    it->second.last_used = ++clock;
+    image.texture = it->second.texture;
+    image.width = it->second.width;
+    image.height = it->second.height;
+    return true;
+}
+
+std::shared_ptr<const std::string> NFX_ResourceCache::get_encoded(const std::string& url)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto it = resources.find(url);
+    if (it == resources.end()) return nullptr;
+    return it->second.encoded;
+}
+
+void NFX_ResourceCache::retain_page(uint64_t page)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    active_pages.insert(page);
+}
+
+void NFX_ResourceCache::release_page(uint64_t page)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!active_pages.erase(page)) return;
+
+    // Other pages may still show the same resources
+    for (auto& pair : resources) {
+        pair.second.pages.erase(page);
+    }
+}
+
+void NFX_ResourceCache::trim()
+{
+    std::vector<SDL_Texture*> doomed;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (stats.texture_bytes <= max_texture_bytes && stats.encoded_bytes <= max_encoded_bytes) return;
+
+        // Oldest first; entries of live pages are skipped
+        std::vector<std::pair<uint64_t, std::string>> order;
+        for (auto& pair : resources) {
+            if (!is_in_use(pair.second)) {
+                order.emplace_back(pair.second.last_used, pair.first);
+            }
+        }
+        std::sort(order.begin(), order.end());
+
+        for (auto& candidate : order) {
+            if (stats.texture_bytes <= max_texture_bytes) break;
+
+            Resource& resource = resources[candidate.second];
+            if (!resource.texture) continue;
+
+            // The encoded bytes, if still present, allow a cheap re-decode later
+            doomed.push_back(resource.texture);
+            resource.texture = nullptr;
+            stats.texture_bytes -= resource.texture_bytes;
+            resource.texture_bytes = 0;
+            stats.evicted_textures++;
+        }
+
+        for (auto& candidate : order) {
+            if (stats.encoded_bytes <= max_encoded_bytes) break;
+
+            Resource& resource = resources[candidate.second];
+            if (!resource.encoded) continue;
+
+            stats.encoded_bytes -= resource.encoded->size();
+            resource.encoded = nullptr;
+            stats.evicted_encoded++;
+
+            if (!resource.texture) {
+                resources.erase(candidate.second);
+            }
+        }
+    }
+
+    for (SDL_Texture* texture : doomed) {
+        SDL_DestroyTexture(texture);
+    }
+}
+
+NFX_ResourceCache::Stats NFX_ResourceCache::get_stats()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
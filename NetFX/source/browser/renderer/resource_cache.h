@@ -0,0 +1,85 @@
+#pragma once
+
+#include <SDL.h>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+
+// Process-wide cache of decoded subresources keyed by absolute URL. Encoded
+// bytes and GPU textures have separate budgets; least recently used entries
+// are evicted first, but never while a page that uses them is still alive.
+class NFX_ResourceCache
+{
+public:
+    // What the caller has to do after request()
+    enum Action {
+        NONE,       // Loaded, loading or failed already
+        FETCH,      // Unknown URL, start a download
+        DECODE      // Texture was evicted but the encoded bytes are still here
+    };
+
+    struct Image {
+        SDL_Texture* texture = nullptr;
+        int width = 0;
+        int height = 0;
+    };
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        size_t encoded_bytes = 0;
+        size_t texture_bytes = 0;
+        uint64_t evicted_encoded = 0;
+        uint64_t evicted_textures = 0;
+    };
+
+private:
+    struct Resource {
+        enum State { LOADING, READY, FAILED } state = LOADING;
+        std::shared_ptr<const std::string> encoded;
+        SDL_Texture* texture = nullptr;
+        int width = 0;
+        int height = 0;
+        size_t texture_bytes = 0;
+        uint64_t last_used = 0;
+        std::set<uint64_t> pages;   // Live pages that referenced it
+    };
+
+    std::unordered_map<std::string, Resource> resources;
+    std::set<uint64_t> active_pages;
+    uint64_t clock = 0;
+    size_t max_encoded_bytes;
+    size_t max_texture_bytes;
+    Stats stats;
+    std::mutex mutex;
+
+    bool is_in_use(const Resource& resource) const;
+
+public:
+    NFX_ResourceCache(size_t max_encoded_bytes, size_t max_texture_bytes);
+    ~NFX_ResourceCache();
+
+    Action request(const std::string& url, uint64_t page);
+
+    void set_encoded(const std::string& url, std::shared_ptr<const std::string> bytes);
+    void set_texture(const std::string& url, SDL_Texture* texture, int width, int height);
+    void set_failed(const std::string& url);
+
+    // Drops an entry whose download was cancelled before it finished
+    void forget(const std::string& url);
+
+    bool get_image(const std::string& url, Image& image);
+    std::shared_ptr<const std::string> get_encoded(const std::string& url);
+
+    // Pages hold on to the resources they reference until released
+    void retain_page(uint64_t page);
+    void release_page(uint64_t page);
+
+    // Applies the budgets; destroys textures, so only call it on the render thread
+    void trim();
+
+    Stats get_stats();
+};
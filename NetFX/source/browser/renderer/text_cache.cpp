@@ -0,0 +1,187 @@
+#include "text_cache.h"
+#include <cstring>
+
+NFX_TextCache::NFX_TextCache(SDL_Renderer* renderer, NFX_GlyphAtlas& atlas, size_t max_bytes)
+    : renderer(renderer), atlas(atlas), max_bytes(max_bytes)
+{
+    // Runs are rendered into transparent targets, which leaves premultiplied pixels
+    blend_mode = SDL_ComposeCustomBlendMode(
+        SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD,
+        SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD);
+
+    if (renderer && SDL_RenderTargetSupported(renderer)) {
+        SDL_Texture* probe = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, 1, 1);
+        enabled = probe && SDL_SetTextureBlendMode(probe, blend_mode) == 0;
+        if (probe) SDL_DestroyTexture(probe);
+    }
+}
+
+NFX_TextCache::~NFX_TextCache()
+{
+    for (auto& entry : lru) {
+        SDL_DestroyTexture(entry.texture);
+    }
+    for (SDL_Texture* texture : retired) {
+        SDL_DestroyTexture(texture);
+    }
+}
+
+bool NFX_TextCache::create(const std::string& key, TTF_Font* font, const char* text, Entry& entry)
+{
+    SDL_Rect bounds = atlas.text_bounds(font, text);
+    if (bounds.w <= 0 || bounds.h <= 0) return false;
+
+    SDL_Texture* texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, bounds.w, bounds.h);
+    if (!texture) return false;
+
+    // Switching targets resets the clip, the caller may be repainting a damaged area
+    SDL_Texture* previous_target = SDL_GetRenderTarget(renderer);
+    SDL_Rect previous_clip;
+    bool had_clip = SDL_RenderIsClipEnabled(renderer);
+    SDL_RenderGetClipRect(renderer, &previous_clip);
+    if (SDL_SetRenderTarget(renderer, texture) != 0) {
+        SDL_DestroyTexture(texture);
+        return false;
+    }
+
+    Uint8 r, g, b, a;
+    SDL_GetRenderDrawColor(renderer, &r, &g, &b, &a);
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+    SDL_RenderClear(renderer);
+
+    SDL_Color white = { 255, 255, 255, 255 };
+    atlas.draw_text(font, text, white, -bounds.x, 0);
+
+    SDL_SetRenderTarget(renderer, previous_target);
+    SDL_RenderSetClipRect(renderer, had_clip ? &previous_clip : nullptr);
+    SDL_SetRenderDrawColor(renderer, r, g, b, a);
+    SDL_SetTextureBlendMode(texture, blend_mode);
+
+    entry.key = key;
+    entry.texture = texture;
+    entry.bounds = bounds;
+    entry.bytes = (size_t)bounds.w * bounds.h * 4;
+    entry.last_frame = frame;
+    return true;
+}
+
+void NFX_TextCache::evict(std::list<Entry>::iterator it)
+{
+    SDL_DestroyTexture(it->texture);
+    stats.bytes -= it->bytes;
+    stats.evicted++;
+    entries.erase(it->key);
+    lru.erase(it);
+}
+
+void NFX_TextCache::draw_text(TTF_Font* font, const char* text, SDL_Color color, int x, int y)
+{
+    if (!font || !text || !*text) return;
+
+    if (!enabled) {
+        atlas.draw_text(font, text, color, x, y);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    key_buffer.assign(reinterpret_cast<const char*>(&font), sizeof(font));
+    key_buffer.append(text);
+
+    const Entry* entry = nullptr;
+    auto it = entries.find(key_buffer);
+    if (it != entries.end()) {
+        lru.splice(lru.begin(), lru, it->second);
+        it->second->last_frame = frame;
+        entry = &*it->second;
+        stats.hits++;
+    }
+    else {
+        stats.misses++;
+
+        auto candidate = candidates.find(key_buffer);
+        if (candidate == candidates.end()) {
+            if (candidates.size() >= MAX_CANDIDATES) candidates.clear();
+            candidates.emplace(key_buffer, frame);
+        }
+        else if (candidate->second != frame && created_this_frame < CREATES_PER_FRAME) {
+            candidates.erase(candidate);
+
+            Entry created;
+            if (create(key_buffer, font, text, created)) {
+                created_this_frame++;
+                stats.bytes += created.bytes;
+                lru.push_front(std::move(created));
+                entries[lru.front().key] = lru.begin();
+                entry = &lru.front();
+            }
+        }
+    }
+
+    if (!entry) {
+        atlas.draw_text(font, text, color, x, y);
+        return;
+    }
+
+    // The texture holds premultiplied white, so the tint carries the alpha too
+    SDL_SetTextureColorMod(entry->texture,
+        (Uint8)(color.r * color.a / 255), (Uint8)(color.g * color.a / 255), (Uint8)(color.b * color.a / 255));
+    SDL_SetTextureAlphaMod(entry->texture, color.a);
+
+    SDL_Rect dst = { x + entry->bounds.x, y, entry->bounds.w, entry->bounds.h };
+    SDL_RenderCopy(renderer, entry->texture, nullptr, &dst);
+}
+
+void NFX_TextCache::trim()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (SDL_Texture* texture : retired) {
+        SDL_DestroyTexture(texture);
+    }
+    retired.clear();
+
+    // Whatever was drawn this frame is on screen and stays
+    while (stats.bytes > max_bytes && !lru.empty() && lru.back().last_frame != frame) {
+        evict(std::prev(lru.end()));
+    }
+
+    frame++;
+    created_this_frame = 0;
+}
+
+void NFX_TextCache::release_font(TTF_Font* font)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // The pointer may be handed out again for a different font
+    for (auto it = lru.begin(); it != lru.end();) {
+        if (std::memcmp(it->key.data(), &font, sizeof(font)) == 0) {
+            retired.push_back(it->texture);
+            stats.bytes -= it->bytes;
+            entries.erase(it->key);
+            it = lru.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+
+    for (auto it = candidates.begin(); it != candidates.end();) {
+        if (std::memcmp(it->first.data(), &font, sizeof(font)) == 0) {
+            it = candidates.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+}
+
+NFX_TextCache::Stats NFX_TextCache::get_stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    Stats result = stats;
+    result.entries = lru.size();
+    return result;
+}
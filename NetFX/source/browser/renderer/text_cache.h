@@ -0,0 +1,81 @@
+#pragma once
+
+#include <SDL.h>
+#include <SDL_ttf.h>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "glyph_atlas.h"
+
+// Keeps whole text runs that are drawn frame after frame as textures, so a
+// static page repaints with one copy per run instead of a quad per glyph.
+// Runs are rendered white from the glyph atlas and tinted when drawn, so
+// one texture serves every color.
+class NFX_TextCache
+{
+public:
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evicted = 0;
+        size_t bytes = 0;
+        size_t entries = 0;
+    };
+
+private:
+    // New textures per frame; the rest are drawn from the atlas until a later frame
+    static const int CREATES_PER_FRAME = 32;
+    static const size_t MAX_CANDIDATES = 4096;
+
+    struct Entry {
+        std::string key;            // Font pointer bytes followed by the text
+        SDL_Texture* texture = nullptr;
+        SDL_Rect bounds = { 0, 0, 0, 0 };
+        size_t bytes = 0;
+        uint64_t last_frame = 0;
+    };
+
+    SDL_Renderer* renderer;
+    NFX_GlyphAtlas& atlas;
+    size_t max_bytes;
+    bool enabled = false;
+    SDL_BlendMode blend_mode = SDL_BLENDMODE_BLEND;
+
+    std::list<Entry> lru;
+    std::unordered_map<std::string_view, std::list<Entry>::iterator> entries;
+
+    // Runs drawn once so far and the frame they were seen in; a texture is
+    // only worth it once a run shows up again in a later frame
+    std::unordered_map<std::string, uint64_t> candidates;
+
+    // Textures of released fonts, destroyed on the render thread in trim()
+    std::vector<SDL_Texture*> retired;
+
+    std::string key_buffer;
+    uint64_t frame = 1;
+    int created_this_frame = 0;
+    Stats stats;
+    mutable std::mutex mutex;
+
+    bool create(const std::string& key, TTF_Font* font, const char* text, Entry& entry);
+    void evict(std::list<Entry>::iterator it);
+
+public:
+    NFX_TextCache(SDL_Renderer* renderer, NFX_GlyphAtlas& atlas, size_t max_bytes);
+    ~NFX_TextCache();
+
+    // Render thread only, like trim()
+    void draw_text(TTF_Font* font, const char* text, SDL_Color color, int x, int y);
+
+    // Ends the frame: runs not drawn in it are evicted first once over budget
+    void trim();
+
+    // May be called from any thread when a font is closed
+    void release_font(TTF_Font* font);
+
+    Stats get_stats() const;
+};
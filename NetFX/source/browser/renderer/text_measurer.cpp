@@ -0,0 +1,263 @@
+#include "text_measurer.h"
+#include "glyph_atlas.h"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    // Basic Latin through Latin Extended-B, then General Punctuation (dashes, quotes)
+    const Uint32 LATIN_FIRST = 0x20;
+    const Uint32 LATIN_LAST = 0x24F;
+    const Uint32 PUNCTUATION_FIRST = 0x2000;
+    const Uint32 PUNCTUATION_LAST = 0x206F;
+    const int TABLE_SIZE = (LATIN_LAST - LATIN_FIRST + 1) + (PUNCTUATION_LAST - PUNCTUATION_FIRST + 1);
+
+    // SDL_ttf reports 0.0.0 when it was built without HarfBuzz
+    bool shapes_with_harfbuzz()
+    {
+        int major = 0, minor = 0, patch = 0;
+        TTF_GetHarfBuzzVersion(&major, &minor, &patch);
+        return major || minor || patch;
+    }
+}
+
+int NFX_TextMeasurer::table_index(Uint32 codepoint)
+{
+    if (codepoint >= LATIN_FIRST && codepoint <= LATIN_LAST) {
+        return codepoint - LATIN_FIRST;
+    }
+    if (codepoint >= PUNCTUATION_FIRST && codepoint <= PUNCTUATION_LAST) {
+        return (LATIN_LAST - LATIN_FIRST + 1) + (codepoint - PUNCTUATION_FIRST);
+    }
+    return -1;
+}
+
+std::unique_lock<std::mutex> NFX_TextMeasurer::lock(TTF_Font* font)
+{
+    return lock_font ? lock_font(font) : std::unique_lock<std::mutex>();
+}
+
+NFX_TextMeasurer::FontTable& NFX_TextMeasurer::get_table(TTF_Font* font)
+{
+    auto it = tables.find(font);
+    if (it != tables.end()) return it->second;
+
+    static const bool harfbuzz = shapes_with_harfbuzz();
+
+    FontTable& table = tables[font];
+    table.shaped = harfbuzz && (!has_layout_tables || has_layout_tables(font));
+    if (table.shaped) return table;
+
+    auto font_lock = lock(font);
+    table.kerning = TTF_GetFontKerning(font) != 0;
+    table.glyphs.resize(TABLE_SIZE);
+    return table;
+}
+
+NFX_TextMeasurer::GlyphMetrics* NFX_TextMeasurer::get_glyph(TTF_Font* font, FontTable& table, Uint32 codepoint)
+{
+    int index = table_index(codepoint);
+    if (index < 0) return nullptr;
+
+    GlyphMetrics& glyph = table.glyphs[index];
+    if (glyph.state == GlyphMetrics::UNKNOWN) {
+        // Missing glyphs fall back to .notdef inside SDL_ttf, leave those to it
+        int minx, maxx, miny, maxy, advance;
+        auto font_lock = lock(font);
+        if (!TTF_GlyphIsProvided32(font, codepoint) ||
+            TTF_GlyphMetrics32(font, codepoint, &minx, &maxx, &miny, &maxy, &advance) != 0) {
+            glyph.state = GlyphMetrics::MISSING;
+        }
+        else {
+            glyph.state = GlyphMetrics::UNVERIFIED;
+            glyph.minx = minx;
+            glyph.width = maxx - minx;
+            glyph.advance = advance;
+        }
+    }
+
+    return glyph.state == GlyphMetrics::MISSING ? nullptr : &glyph;
+}
+
+NFX_TextMeasurer::PairMetrics& NFX_TextMeasurer::get_pair(TTF_Font* font, FontTable& table, Uint32 prev, Uint32 codepoint)
+{
+    uint32_t key = (uint32_t)table_index(prev) << 16 | (uint32_t)table_index(codepoint);
+
+    auto it = table.pairs.find(key);
+    if (it != table.pairs.end()) return it->second;
+
+    PairMetrics& pair = table.pairs[key];
+    auto font_lock = lock(font);
+    pair.kerning = table.kerning ? TTF_GetFontKerningSizeGlyphs32(font, prev, codepoint) : 0;
+    return pair;
+}
+
+bool NFX_TextMeasurer::table_width(TTF_Font* font, FontTable& table, const char* text, int& width, bool& trusted)
+{
+    // Same pen walk as SDL_ttf: kern, place the glyph box, advance
+    int x = 0;
+    int minx = 0;
+    int maxx = 0;
+    Uint32 prev = 0;
+    trusted = true;
+
+    while (*text) {
+        const char* start = text;
+        Uint32 codepoint = NFX_GlyphAtlas::decode_utf8(text);
+        if (codepoint < 0x80 && text - start > 1) return false; // Overlong encoding
+
+        GlyphMetrics* glyph = get_glyph(font, table, codepoint);
+        if (!glyph) return false;
+        if (glyph->state != GlyphMetrics::VERIFIED) trusted = false;
+
+        if (prev) {
+            PairMetrics& pair = get_pair(font, table, prev, codepoint);
+            if (pair.state == PairMetrics::BAD) return false;
+            if (pair.state != PairMetrics::VERIFIED) trusted = false;
+            x += pair.kerning;
+        }
+        prev = codepoint;
+
+        int pos = x + glyph->minx;
+        minx = std::min(minx, pos);
+        maxx = std::max(maxx, pos + glyph->width);
+        x += glyph->advance;
+    }
+
+    maxx = std::max(maxx, x);
+    width = maxx - minx;
+    return true;
+}
+
+void NFX_TextMeasurer::learn(TTF_Font* font, FontTable& table, const char* text, bool matched)
+{
+    // A match vouches for every glyph and pair in the text. A mismatch cannot be
+    // pinned on one of them, so all pairs not yet vouched for stop using the table.
+    Uint32 prev = 0;
+    while (*text) {
+        Uint32 codepoint = NFX_GlyphAtlas::decode_utf8(text);
+        GlyphMetrics* glyph = get_glyph(font, table, codepoint);
+        if (!glyph) return;
+
+        if (matched) glyph->state = GlyphMetrics::VERIFIED;
+
+        if (prev) {
+            PairMetrics& pair = get_pair(font, table, prev, codepoint);
+            if (pair.state == PairMetrics::UNVERIFIED) {
+                pair.state = matched ? PairMetrics::VERIFIED : PairMetrics::BAD;
+            }
+        }
+        prev = codepoint;
+    }
+}
+
+int NFX_TextMeasurer::measure(TTF_Font* font, const char* text)
+{
+    Uint64 start = SDL_GetPerformanceCounter();
+
+    int width = 0;
+    int height = 0;
+    {
+        auto font_lock = lock(font);
+        if (TTF_SizeUTF8(font, text, &width, &height) != 0) {
+            width = 0;
+        }
+    }
+
+    measure_ticks += SDL_GetPerformanceCounter() - start;
+    stats.misses++;
+    return width;
+}
+
+int NFX_TextMeasurer::lookup(TTF_Font* font, FontTable& table, const char* text)
+{
+    int estimate = 0;
+    bool trusted = false;
+    bool tabled = !table.shaped && table_width(font, table, text, estimate, trusted);
+    if (tabled && trusted) {
+        stats.table_hits++;
+        return estimate;
+    }
+
+    key_buffer.assign(reinterpret_cast<const char*>(&font), sizeof(font));
+    key_buffer.append(text);
+
+    auto it = entries.find(key_buffer);
+    if (it != entries.end()) {
+        lru.splice(lru.begin(), lru, it->second);
+        stats.lru_hits++;
+        return it->second->width;
+    }
+
+    int width = measure(font, text);
+
+    if (tabled) {
+        learn(font, table, text, estimate == width);
+
+        // The table can answer this one next time, keep the LRU for the rest
+        if (estimate == width) return width;
+        stats.mismatches++;
+    }
+
+    lru.push_front({ key_buffer, width });
+    entries[lru.front().key] = lru.begin();
+
+    if (lru.size() > MAX_ENTRIES) {
+        entries.erase(lru.back().key);
+        lru.pop_back();
+    }
+
+    return width;
+}
+
+int NFX_TextMeasurer::text_width(TTF_Font* font, const char* text)
+{
+    if (!font || !text) return 0;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    return lookup(font, get_table(font), text);
+}
+
+void NFX_TextMeasurer::text_widths(TTF_Font* font, const char* const* texts, int* widths, size_t count)
+{
+    if (!font) {
+        std::fill(widths, widths + count, 0);
+        return;
+    }
+
+    // One lock and one table lookup for the whole batch
+    std::lock_guard<std::mutex> lock(mutex);
+    FontTable& table = get_table(font);
+
+    for (size_t i = 0; i < count; i++) {
+        widths[i] = texts[i] ? lookup(font, table, texts[i]) : 0;
+    }
+}
+
+void NFX_TextMeasurer::release_font(TTF_Font* font)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    tables.erase(font);
+
+    // The pointer may be handed out again for a different font
+    for (auto it = lru.begin(); it != lru.end();) {
+        if (std::memcmp(it->key.data(), &font, sizeof(font)) == 0) {
+            entries.erase(it->key);
+            it = lru.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+}
+
+NFX_TextMeasurer::Stats NFX_TextMeasurer::get_stats()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    Stats result = stats;
+    result.entries = lru.size();
+    result.measure_ms = measure_ticks * 1000.0 / SDL_GetPerformanceFrequency();
+    return result;
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <SDL.h>
+#include <SDL_ttf.h>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Memoizes text widths so words are not run through FreeType again on every
+// restyle. Common characters are measured from per-font glyph tables; every
+// glyph and pair is checked against TTF_SizeUTF8 before the table is trusted
+// with it, everything else goes through a bounded LRU of exact results.
+//
+// The tables assume a run is as wide as its glyphs and kerned pairs. When
+// SDL_ttf shapes with HarfBuzz, ligatures and contextual positioning can
+// break that for fonts with layout tables, so those fonts only use the LRU.
+class NFX_TextMeasurer
+{
+public:
+    struct Stats {
+        uint64_t table_hits = 0;
+        uint64_t lru_hits = 0;
+        uint64_t misses = 0;
+        uint64_t mismatches = 0;    // Table results SDL_ttf disagreed with
+        size_t entries = 0;
+        double measure_ms = 0.0;    // Time spent inside TTF_SizeUTF8
+
+        // Assumes every hit would have cost an average miss
+        double saved_ms() const {
+            return misses ? (table_hits + lru_hits) * measure_ms / misses : 0.0;
+        }
+    };
+
+private:
+    static const size_t MAX_ENTRIES = 16384;
+
+    struct GlyphMetrics {
+        enum State : Uint8 { UNKNOWN, MISSING, UNVERIFIED, VERIFIED };
+        State state = UNKNOWN;
+        int minx = 0;
+        int width = 0;
+        int advance = 0;
+    };
+
+    struct PairMetrics {
+        enum State : Uint8 { UNVERIFIED, VERIFIED, BAD };
+        State state = UNVERIFIED;
+        int kerning = 0;
+    };
+
+    struct FontTable {
+        bool kerning = false;
+        bool shaped = false;    // Widths depend on whole runs, the tables are not used
+        std::vector<GlyphMetrics> glyphs;
+        std::unordered_map<uint32_t, PairMetrics> pairs;
+    };
+
+    struct Entry {
+        std::string key;        // Font pointer bytes followed by the text
+        int width;
+    };
+
+    std::unordered_map<TTF_Font*, FontTable> tables;
+    std::list<Entry> lru;
+    std::unordered_map<std::string_view, std::list<Entry>::iterator> entries;
+    std::string key_buffer;
+    Stats stats;
+    Uint64 measure_ticks = 0;
+    std::mutex mutex;
+
+    static int table_index(Uint32 codepoint);
+    FontTable& get_table(TTF_Font* font);
+    GlyphMetrics* get_glyph(TTF_Font* font, FontTable& table, Uint32 codepoint);
+    PairMetrics& get_pair(TTF_Font* font, FontTable& table, Uint32 prev, Uint32 codepoint);
+
+    // Width from the tables; trusted is false if any glyph or pair has not been verified yet
+    bool table_width(TTF_Font* font, FontTable& table, const char* text, int& width, bool& trusted);
+    void learn(TTF_Font* font, FontTable& table, const char* text, bool matched);
+    int measure(TTF_Font* font, const char* text);
+    int lookup(TTF_Font* font, FontTable& table, const char* text);
+
+    std::unique_lock<std::mutex> lock(TTF_Font* font);
+
+public:
+    // Serializes SDL_ttf calls on fonts shared with the render thread; held
+    // around single calls only, while the measurer's own mutex is held
+    std::function<std::unique_lock<std::mutex>(TTF_Font*)> lock_font;
+
+    // Whether a font has layout tables a shaper would apply; without it
+    // every font is assumed to have them
+    std::function<bool(TTF_Font*)> has_layout_tables;
+
+    int text_width(TTF_Font* font, const char* text);
+    void text_widths(TTF_Font* font, const char* const* texts, int* widths, size_t count);
+
+    // Forgets everything about a font that is about to be closed
+    void release_font(TTF_Font* font);
+
+    Stats get_stats();
+};
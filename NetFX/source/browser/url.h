@@ -0,0 +1,131 @@
+#pragma once
+
+#include <string>
+
+class NFX_Url
+{
+public:
+    std::string schema;
+    std::string hostname;
+    std::string path;
+    int port;
+
+    NFX_Url(const std::string& url) {
+        parse_url(url);
+    }
+
+    std::string to_str() const {
+        std::string result = schema + "://" + hostname;
+
+        // Add port if it's not the default
+        if ((schema == "http" && port != 80) ||
+            (schema == "https" && port != 443)) {
+            result += ":" + std::to_string(port);
+        }
+
+        result += path;
+        return result;
+    }
+
+    bool is_https() const {
+        return schema == "https";
+    }
+
+    bool is_valid() const {
+        return !schema.empty() && !hostname.empty();
+    }
+
+    // Resolves a reference such as a Location header against this URL
+    NFX_Url resolve(const std::string& ref) const {
+        if (ref.find("://") != std::string::npos) {
+            return NFX_Url(ref);
+        }
+
+        // Authority part without the default port
+        std::string base = to_str();
+        base = base.substr(0, base.size() - path.size());
+
+        if (ref.compare(0, 2, "//") == 0) {
+            return NFX_Url(schema + ":" + ref);
+        }
+        if (!ref.empty() && ref[0] == '/') {
+            return NFX_Url(base + ref);
+        }
+
+        // Relative to the directory of the current path
+        std::string dir = path.substr(0, path.rfind('/') + 1);
+        return NFX_Url(base + dir + ref);
+    }
+
+    // scheme://host:port with the port always spelled out, used to key connections
+    std::string origin() const {
+        return schema + "://" + hostname + ":" + std::to_string(port);
+    }
+
+private:
+    void parse_url(const std::string& url) {
+        // Default values
+        schema = "";
+        hostname = "";
+        path = "/";
+        port = 80;
+
+        if (url.empty()) return;
+
+        std::string remaining = url;
+
+        // Extract schema
+        size_t schema_pos = remaining.find("://");
+        if (schema_pos != std::string::npos) {
+            schema = remaining.substr(0, schema_pos);
+            remaining = remaining.substr(schema_pos + 3);
+
+            // Set default port based on schema
+            if (schema == "https") {
+                port = 443;
+            }
+            else if (schema == "http") {
+                port = 80;
+            }
+        }
+        else {
+            // No schema, assume http
+            schema = "http";
+            port = 80;
+        }
+
+        // Extract hostname and optional port
+        size_t path_pos = remaining.find('/');
+        std::string host_part;
+
+        if (path_pos != std::string::npos) {
+            host_part = remaining.substr(0, path_pos);
+            path = remaining.substr(path_pos);
+        }
+        else {
+            host_part = remaining;
+            path = "/";
+        }
+
+        // Check for port in hostname
+        size_t port_pos = host_part.find(':');
+        if (port_pos != std::string::npos) {
+            hostname = host_part.substr(0, port_pos);
+            std::string port_str = host_part.substr(port_pos + 1);
+            try {
+                port = std::stoi(port_str);
+            }
+            catch (...) {
+                // Invalid port, keep default
+            }
+        }
+        else {
+            hostname = host_part;
+        }
+
+        // Ensure path starts with '/'
+        if (!path.empty() && path[0] != '/') {
+            path = "/" + path;
+        }
+    }
+};
@@ -26,7 +26,7 @@ int main(int argc, char* argv[])
     // Create window and renderer
     SDL_Window* window = SDL_CreateWindow("NetFX",
         SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
-        800, 600, SDL_WINDOW_SHOWN);
+        800, 600, SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE);
 
     if (!window) 
     {
@@ -43,15 +43,51 @@ int main(int argc, char* argv[])
     SDL_Event e;
     int quit = 0;
 
+    // Motion events are coalesced so hover restyles at most once per frame
+    bool mouseMoved = false;
+    int mouseX = 0;
+    int mouseY = 0;
+
     while (!quit) 
     {
-        while (SDL_PollEvent(&e)) 
+        // Sleep until input, a worker's wake-up or timed work in the browser
+        int hasEvent = SDL_WaitEventTimeout(&e, (int)browser->get_wait_timeout());
+
+        for (; hasEvent; hasEvent = SDL_PollEvent(&e)) 
         {
             if (e.type == SDL_QUIT) 
             {
                 quit = 1;
             }
 
+            if (e.type == SDL_MOUSEMOTION)
+            {
+                mouseMoved = true;
+                mouseX = e.motion.x;
+                mouseY = e.motion.y;
+            }
+            else
+            if (e.type == SDL_WINDOWEVENT && e.window.event == SDL_WINDOWEVENT_LEAVE)
+            {
+                mouseMoved = false;
+                browser->handle_mouse_leave();
+            }
+            else
+            if (e.type == SDL_WINDOWEVENT && e.window.event == SDL_WINDOWEVENT_SIZE_CHANGED)
+            {
+                browser->handle_resize();
+            }
+            else
+            if (e.type == SDL_WINDOWEVENT && e.window.event == SDL_WINDOWEVENT_EXPOSED)
+            {
+                browser->request_redraw();
+            }
+            else
+            if (e.type == SDL_RENDER_TARGETS_RESET || e.type == SDL_RENDER_DEVICE_RESET)
+            {
+                browser->invalidate_page();
+            }
+            else
             if (e.type == SDL_MOUSEBUTTONDOWN)
             {
                 if (e.button.button == SDL_BUTTON_LEFT) {
@@ -64,6 +100,9 @@ int main(int argc, char* argv[])
             else
             if (e.type == SDL_KEYDOWN) 
             {
+                // The search bar is drawn over the page
+                browser->request_redraw();
+
                 SDL_Keymod mod = SDL_GetModState();
 
                 // Toggle search bar with Alt key (pressed down)
@@ -99,12 +138,17 @@ int main(int argc, char* argv[])
             // Capture text input
             if (e.type == SDL_TEXTINPUT && searchBarActive) {
                 searchText.append(e.text.text);
+                browser->request_redraw();
             }
         }
 
-        browser->render();
+        if (mouseMoved)
+        {
+            browser->handle_mouse_move(mouseX, mouseY);
+            mouseMoved = false;
+        }
 
-        SDL_Delay(16); // ~60 FPS
+        browser->render();
     }
 
     delete browser;
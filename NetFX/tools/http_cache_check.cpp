@@ -0,0 +1,227 @@
+// Checks the disk HTTP cache end to end against a local httplib server.
+//
+// Not part of the NetFX project. Build it out of tree from the NetFX directory
+// with the same httplib features the browser uses:
+//
+//   g++ -std=c++17 -O1 -Ilib/httplib
+//       -DCPPHTTPLIB_OPENSSL_SUPPORT -DCPPHTTPLIB_ZLIB_SUPPORT -DCPPHTTPLIB_BROTLI_SUPPORT
+//       tools/http_cache_check.cpp source/browser/net/http_cache.cpp
+//       source/browser/net/fetch_scheduler.cpp source/browser/net/connection_pool.cpp
+//       -lssl -lcrypto -lz -lbrotlienc -lbrotlidec -lbrotlicommon -pthread
+//       -o http_cache_check
+//
+// Every fetch goes through NFX_FetchScheduler, as in the browser. The server
+// counts the requests it sees, and each check compares those counts with
+// what the cache should have answered by itself. Exits non-zero on failure.
+
+#include <httplib.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <future>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "../source/browser/net/connection_pool.h"
+#include "../source/browser/net/fetch_scheduler.h"
+#include "../source/browser/net/http_cache.h"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    const char* LAST_MODIFIED = "Sun, 06 Nov 1994 08:49:37 GMT";
+
+    std::map<std::string, int> hits;
+    std::mutex hits_mutex;
+    int failures = 0;
+
+    int hits_for(const std::string& path)
+    {
+        std::lock_guard<std::mutex> lock(hits_mutex);
+        return hits[path];
+    }
+
+    void check(bool ok, const char* what)
+    {
+        printf("  %-56s %s\n", what, ok ? "ok" : "FAILED");
+        if (!ok) failures++;
+    }
+
+    struct Fetched {
+        int status = 0;
+        std::string body;
+    };
+
+    // One scheduled fetch, waited for; streamed requests collect on_data chunks
+    Fetched fetch(NFX_FetchScheduler& scheduler, const std::string& url, bool streamed = false)
+    {
+        auto result = std::make_shared<std::promise<Fetched>>();
+        auto streamed_body = std::make_shared<std::string>();
+
+        NFX_FetchRequest request((NFX_Url(url)));
+        request.follow_location = true;
+        if (streamed) {
+            request.on_data = [streamed_body](const char* data, size_t length) {
+                streamed_body->append(data, length);
+                return true;
+            };
+        }
+        request.on_complete = [result, streamed_body, streamed](httplib::Result& res) {
+            Fetched fetched;
+            if (res) {
+                fetched.status = res->status;
+                fetched.body = streamed ? *streamed_body : res->body;
+            }
+            result->set_value(fetched);
+        };
+        request.on_cancel = [result]() { result->set_value(Fetched()); };
+
+        auto future = result->get_future();
+        scheduler.submit(std::move(request));
+        return future.get();
+    }
+
+    void serve(httplib::Server& server)
+    {
+        // Counted before the response goes out, the logger would race the client
+        server.set_pre_routing_handler([](const httplib::Request& req, httplib::Response&) {
+            std::lock_guard<std::mutex> lock(hits_mutex);
+            hits[req.path]++;
+            return httplib::Server::HandlerResponse::Unhandled;
+        });
+
+        server.Get("/fresh", [](const httplib::Request&, httplib::Response& res) {
+            res.set_header("Cache-Control", "max-age=600");
+            res.set_content("fresh body", "text/plain");
+        });
+        server.Get("/streamed", [](const httplib::Request&, httplib::Response& res) {
+            res.set_header("Cache-Control", "max-age=600");
+            res.set_content(std::string(200 * 1024, 's'), "text/html");
+        });
+        server.Get("/etag", [](const httplib::Request& req, httplib::Response& res) {
+            res.set_header("Cache-Control", "no-cache");
+            res.set_header("ETag", "\"v1\"");
+            if (req.get_header_value("If-None-Match") == "\"v1\"") {
+                res.status = 304;
+                return;
+            }
+            res.set_content("etag body", "text/plain");
+        });
+        server.Get("/last-modified", [](const httplib::Request& req, httplib::Response& res) {
+            res.set_header("Cache-Control", "max-age=0");
+            res.set_header("Last-Modified", LAST_MODIFIED);
+            if (req.get_header_value("If-Modified-Since") == LAST_MODIFIED) {
+                res.status = 304;
+                return;
+            }
+            res.set_content("last-modified body", "text/plain");
+        });
+        server.Get("/moved", [](const httplib::Request&, httplib::Response& res) {
+            res.status = 301;
+            res.set_header("Location", "/target");
+        });
+        server.Get("/target", [](const httplib::Request&, httplib::Response& res) {
+            res.set_content("target body", "text/plain");
+        });
+        server.Get("/no-store", [](const httplib::Request&, httplib::Response& res) {
+            res.set_header("Cache-Control", "no-store");
+            res.set_content("no-store body", "text/plain");
+        });
+        server.Get(R"(/big/(\w+))", [](const httplib::Request&, httplib::Response& res) {
+            res.set_header("Cache-Control", "max-age=600");
+            res.set_content(std::string(40 * 1024, 'b'), "application/octet-stream");
+        });
+    }
+}
+
+int main()
+{
+    httplib::Server server;
+    serve(server);
+    int port = server.bind_to_any_port("127.0.0.1");
+    std::thread server_thread([&]() { server.listen_after_bind(); });
+    server.wait_until_ready();
+
+    std::string origin = "http://127.0.0.1:" + std::to_string(port);
+    fs::path directory = fs::temp_directory_path() / "nfx_http_cache_check";
+    std::error_code ec;
+    fs::remove_all(directory, ec);
+
+    {
+        NFX_ConnectionPool pool;
+        NFX_HttpCache cache(directory.string(), 16 * 1024 * 1024);
+        NFX_FetchScheduler scheduler(&pool, &cache);
+
+        printf("fresh max-age\n");
+        Fetched first = fetch(scheduler, origin + "/fresh");
+        Fetched second = fetch(scheduler, origin + "/fresh");
+        check(first.body == "fresh body" && second.body == first.body, "same body both times");
+        check(hits_for("/fresh") == 1, "second fetch served from the cache");
+
+        printf("streamed body\n");
+        first = fetch(scheduler, origin + "/streamed", true);
+        second = fetch(scheduler, origin + "/streamed", true);
+        check(first.body.size() == 200 * 1024 && second.body == first.body, "same body both times");
+        check(hits_for("/streamed") == 1, "second fetch served from the cache");
+
+        printf("ETag revalidation\n");
+        first = fetch(scheduler, origin + "/etag");
+        second = fetch(scheduler, origin + "/etag");
+        check(second.status == 200 && second.body == "etag body", "304 answered with the stored body");
+        check(hits_for("/etag") == 2 && cache.get_stats().revalidated >= 1, "revalidated, not refetched");
+
+        printf("Last-Modified revalidation\n");
+        first = fetch(scheduler, origin + "/last-modified");
+        second = fetch(scheduler, origin + "/last-modified");
+        check(second.status == 200 && second.body == "last-modified body", "304 answered with the stored body");
+        check(hits_for("/last-modified") == 2 && cache.get_stats().revalidated >= 2, "revalidated, not refetched");
+
+        printf("permanent redirect\n");
+        first = fetch(scheduler, origin + "/moved");
+        second = fetch(scheduler, origin + "/moved");
+        check(first.body == "target body" && second.body == "target body", "redirect followed");
+        check(hits_for("/moved") == 1, "301 remembered");
+
+        printf("no-store\n");
+        fetch(scheduler, origin + "/no-store");
+        second = fetch(scheduler, origin + "/no-store");
+        check(second.body == "no-store body", "body delivered");
+        check(hits_for("/no-store") == 2, "never served from the cache");
+    }
+
+    {
+        // A fresh cache with room for two of the 40 KiB /big bodies. Access times
+        // have one second resolution, so the stores are spaced out to give the
+        // least recently used order a single answer.
+        const uint64_t BUDGET = 100 * 1024;
+        fs::remove_all(directory, ec);
+        NFX_ConnectionPool pool;
+        NFX_HttpCache cache(directory.string(), BUDGET);
+        NFX_FetchScheduler scheduler(&pool, &cache);
+
+        printf("eviction\n");
+        const char* names[] = { "a", "b", "c" };
+        for (const char* name : names) {
+            fetch(scheduler, origin + "/big/" + name);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+        }
+        NFX_HttpCache::Stats stats = cache.get_stats();
+        check(stats.evicted == 1, "oldest entry evicted");
+        check(stats.bytes <= BUDGET, "stored bytes within the budget");
+
+        fetch(scheduler, origin + "/big/c");
+        check(hits_for("/big/c") == 1, "newest entry still served from the cache");
+        fetch(scheduler, origin + "/big/a");
+        check(hits_for("/big/a") == 2, "evicted entry fetched again");
+    }
+
+    server.stop();
+    server_thread.join();
+    fs::remove_all(directory, ec);
+
+    printf("%s\n", failures ? "FAILED" : "all checks passed");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,303 @@
+// Microbenchmark for litehtml::scan_utf8_text and the split_text built on it.
+//
+// Not part of the NetFX project. Build it out of tree from the NetFX directory:
+//
+//   g++ -std=c++17 -O2 -Ilib/litehtml/include -Ilib/litehtml/include/litehtml
+//       tools/utf8_split_bench.cpp lib/litehtml/include/litehtml/utf8_strings.cpp
+//       -o utf8_split_bench
+//
+// Add -mavx2 for the 32 byte blocks, or -U__SSE2__ for the scalar scan.
+//
+// Before timing, the old and new splits are compared on random mixed strings,
+// and the scan must reject a set of hand picked invalid sequences. Then each
+// corpus is timed three ways: the wstring based split_text that the scanner
+// replaced, the current split_text, and the scan alone.
+
+#include <litehtml.h>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace litehtml;
+
+namespace
+{
+    // Keeps the timed loops from being optimized away
+    volatile size_t sink;
+
+    using split_fn = void (*)(const char* text, const std::function<void(const char*)>& on_word,
+        const std::function<void(const char*)>& on_space);
+
+    // document_container::split_text before the scanner, unchanged
+    void old_split_text(const char* text, const std::function<void(const char*)>& on_word,
+        const std::function<void(const char*)>& on_space)
+    {
+        std::wstring str;
+        std::wstring str_in = (const wchar_t*)utf8_to_wchar(text);
+        ucode_t c;
+        for (size_t i = 0; i < str_in.length(); i++)
+        {
+            c = (ucode_t)str_in[i];
+            if (c <= ' ' && (c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f'))
+            {
+                if (!str.empty())
+                {
+                    on_word(wchar_to_utf8(str.c_str()));
+                    str.clear();
+                }
+                str += c;
+                on_space(wchar_to_utf8(str.c_str()));
+                str.clear();
+            }
+            // CJK character range
+            else if (c >= 0x4E00 && c <= 0x9FCC)
+            {
+                if (!str.empty())
+                {
+                    on_word(wchar_to_utf8(str.c_str()));
+                    str.clear();
+                }
+                str += c;
+                on_word(wchar_to_utf8(str.c_str()));
+                str.clear();
+            }
+            else
+            {
+                str += c;
+            }
+        }
+        if (!str.empty())
+        {
+            on_word(wchar_to_utf8(str.c_str()));
+        }
+    }
+
+    // document_container::split_text; document_container is abstract, so the body is repeated here
+    void new_split_text(const char* text, const std::function<void(const char*)>& on_word,
+        const std::function<void(const char*)>& on_space)
+    {
+        if (!text) return;
+
+        std::vector<text_piece> pieces;
+        scan_utf8_text(text, strlen(text), pieces);
+
+        string word;
+        string single;
+        for (const auto& pc : pieces)
+        {
+            switch (pc.cls)
+            {
+            case text_piece_word:
+                word.append(text + pc.offset, pc.length);
+                break;
+            case text_piece_invalid:
+                word += '?';
+                break;
+            default:
+                if (!word.empty())
+                {
+                    on_word(word.c_str());
+                    word.clear();
+                }
+                single.assign(text + pc.offset, pc.length);
+                if (pc.cls == text_piece_space)
+                {
+                    on_space(single.c_str());
+                }
+                else
+                {
+                    on_word(single.c_str());
+                }
+                break;
+            }
+        }
+        if (!word.empty())
+        {
+            on_word(word.c_str());
+        }
+    }
+
+    // Words are prefixed with 'w', spaces with 's', so both kinds compare in one list
+    std::vector<std::string> collect(split_fn split, const std::string& text)
+    {
+        std::vector<std::string> out;
+        split(text.c_str(),
+            [&](const char* word) { out.push_back(std::string("w") + word); },
+            [&](const char* space) { out.push_back(std::string("s") + space); });
+        return out;
+    }
+
+    void append_utf8(std::string& out, uint32_t c)
+    {
+        if (c < 0x80) {
+            out += (char)c;
+        }
+        else if (c < 0x800) {
+            out += (char)(0xC0 | (c >> 6));
+            out += (char)(0x80 | (c & 0x3F));
+        }
+        else if (c < 0x10000) {
+            out += (char)(0xE0 | (c >> 12));
+            out += (char)(0x80 | ((c >> 6) & 0x3F));
+            out += (char)(0x80 | (c & 0x3F));
+        }
+        else {
+            out += (char)(0xF0 | (c >> 18));
+            out += (char)(0x80 | ((c >> 12) & 0x3F));
+            out += (char)(0x80 | ((c >> 6) & 0x3F));
+            out += (char)(0x80 | (c & 0x3F));
+        }
+    }
+
+    // Mostly ASCII words with the occasional accented letter, CJK ideograph,
+    // astral character and every kind of white space
+    std::string random_mixed(std::mt19937& rng, size_t chars)
+    {
+        static const uint32_t pool[] = {
+            'a', 'b', 'e', 'k', 'z', 'A', 'Q', '0', '9', '.', ',', '-', '!',
+            ' ', ' ', '\t', '\n', '\r', '\f', 0xE9, 0xFC, 0x3B1, 0x416, 0x20AC,
+            0x4E00, 0x4E2D, 0x9FCC, 0x9FCD, 0x3042, 0xAC00, 0x1F600, 0x10348
+        };
+        std::uniform_int_distribution<size_t> pick(0, sizeof(pool) / sizeof(pool[0]) - 1);
+
+        std::string out;
+        for (size_t i = 0; i < chars; i++) {
+            append_utf8(out, pool[pick(rng)]);
+        }
+        return out;
+    }
+
+    std::string make_prose(size_t bytes)
+    {
+        static const char* words[] = {
+            "the", "layout", "of", "a", "document", "is", "computed", "from", "its", "boxes",
+            "and", "every", "line", "breaks", "at", "white", "space", "between", "words", "text"
+        };
+        std::mt19937 rng(1);
+        std::uniform_int_distribution<size_t> pick(0, sizeof(words) / sizeof(words[0]) - 1);
+
+        std::string out;
+        while (out.size() < bytes) {
+            out += words[pick(rng)];
+            out += (out.size() % 97 == 0) ? '\n' : ' ';
+        }
+        return out;
+    }
+
+    std::string make_accented(size_t bytes)
+    {
+        static const char* words[] = {
+            "caf\xC3\xA9", "na\xC3\xAFve", "gar\xC3\xA7on", "\xC3\xBC" "ber", "stra\xC3\x9F" "e",
+            "\xCE\xB1\xCE\xB2\xCE\xB3", "\xD0\xBC\xD0\xB8\xD1\x80", "plain", "words", "here"
+        };
+        std::mt19937 rng(2);
+        std::uniform_int_distribution<size_t> pick(0, sizeof(words) / sizeof(words[0]) - 1);
+
+        std::string out;
+        while (out.size() < bytes) {
+            out += words[pick(rng)];
+            out += ' ';
+        }
+        return out;
+    }
+
+    std::string make_cjk(size_t bytes)
+    {
+        std::mt19937 rng(3);
+        std::uniform_int_distribution<uint32_t> pick(0x4E00, 0x9FCC);
+
+        std::string out;
+        while (out.size() < bytes) {
+            append_utf8(out, pick(rng));
+            if (out.size() % 60 < 3) out += ' ';
+        }
+        return out;
+    }
+
+    template <typename F>
+    double megabytes_per_second(size_t bytes, F&& run)
+    {
+        // Repeat until the timing is long enough to be stable, keep the best round
+        double best = 0;
+        for (int round = 0; round < 5; round++) {
+            int iterations = 0;
+            auto start = std::chrono::steady_clock::now();
+            double seconds = 0;
+            do {
+                run();
+                iterations++;
+                seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            } while (seconds < 0.2);
+
+            double rate = (double)bytes * iterations / seconds / (1024.0 * 1024.0);
+            if (rate > best) best = rate;
+        }
+        return best;
+    }
+
+    void bench(const char* name, const std::string& text)
+    {
+        auto count_word = [](const char* word) { sink = sink + word[0]; };
+        auto count_space = [](const char* space) { sink = sink + space[0]; };
+        std::vector<text_piece> pieces;
+
+        double old_rate = megabytes_per_second(text.size(), [&] { old_split_text(text.c_str(), count_word, count_space); });
+        double new_rate = megabytes_per_second(text.size(), [&] { new_split_text(text.c_str(), count_word, count_space); });
+        double scan_rate = megabytes_per_second(text.size(), [&] {
+            scan_utf8_text(text.c_str(), text.size(), pieces);
+            sink = sink + pieces.size();
+        });
+
+        printf("  %-16s %6zu KB  %6.0f / %6.0f / %6.0f MB/s\n",
+            name, text.size() / 1024, old_rate, new_rate, scan_rate);
+    }
+}
+
+int main()
+{
+    int failures = 0;
+
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<size_t> length(0, 64);
+    for (int i = 0; i < 200000; i++) {
+        std::string text = random_mixed(rng, length(rng));
+        if (collect(old_split_text, text) != collect(new_split_text, text)) {
+            if (failures++ < 5) printf("mismatch on random string %d\n", i);
+        }
+    }
+
+    // Overlongs, surrogates, code points past U+10FFFF, stray and missing continuation bytes
+    static const char* invalid[] = {
+        "a\xC0\xAF" "b", "\xE0\x80\xAF", "\xED\xA0\x80 x", "\xF4\x90\x80\x80", "\xF5\x80",
+        "\x80\x80 y", "\xC3", "\xE4\xB8", "z\xF0\x9F\x98", "\xFF\xFE ok"
+    };
+    std::vector<text_piece> pieces;
+    for (const char* text : invalid) {
+        if (scan_utf8_text(text, strlen(text), pieces)) {
+            printf("invalid input accepted: ");
+            for (const char* p = text; *p; p++) printf("%02X ", (unsigned char)*p);
+            printf("\n");
+            failures++;
+        }
+    }
+
+    printf("%s\n", failures ? "FAILED" : "old and new split_text agree");
+
+#if defined(__AVX2__)
+    const char* scan_kind = "AVX2";
+#elif defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+    const char* scan_kind = "SSE2";
+#else
+    const char* scan_kind = "scalar";
+#endif
+    printf("old split_text / new split_text / scan only (%s):\n", scan_kind);
+    bench("prose", make_prose(120 * 1024));
+    bench("accented mix", make_accented(120 * 1024));
+    bench("CJK", make_cjk(120 * 1024));
+
+    return failures ? 1 : 0;
+}